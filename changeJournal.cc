@@ -0,0 +1,317 @@
+/*
+  @copyright Steve Keen 2013
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "changeJournal.h"
+#include "minsky.h"
+#include "str.h"
+#include <ecolab_epilogue.h>
+
+#include <sstream>
+#include <stdlib.h>
+
+using namespace std;
+using namespace minsky;
+
+namespace minsky
+{
+  /// the attributes of a canvas item that its drawing depends on
+  struct ItemState
+  {
+    bool drawn; ///< whether the item is drawn on the canvas at all
+    vector<double> values;
+    string text;
+    ItemState(): drawn(false) {}
+    ItemState& operator<<(double x) {values.push_back(x); return *this;}
+    ItemState& operator<<(const string& x) {text+=x; text+='\0'; return *this;}
+    bool operator==(const ItemState& x) const 
+    {return drawn==x.drawn && values==x.values && text==x.text;}
+  };
+
+  struct CanvasState
+  {
+    typedef ChangeJournal::Kind Kind;
+    typedef pair<Kind, string> Key;
+    struct Entry
+    {
+      ItemState state;
+      const void* object; ///< the model object the state was taken from
+    };
+    /// every item of the model as last drained, drawn or not
+    typedef map<string, Entry> Entries;
+    Entries entries[ChangeJournal::numKinds];
+    /// the item drained for each object, for touched(const void*)
+    map<const void*, Key> owners;
+    /// items reported as changed since the last drain
+    set<Key> dirty;
+    /// whether entries reflects all the items, as counted at the last
+    /// drain
+    IndexState synced;
+
+    size_t size() const {
+      size_t n=0;
+      for (int k=0; k<ChangeJournal::numKinds; ++k) n+=entries[k].size();
+      return n;
+    }
+
+    void disown(Entries::iterator e, const Key& key)
+    {
+      map<const void*, Key>::iterator o=owners.find(e->second.object);
+      if (o!=owners.end() && o->second==key)
+        owners.erase(o);
+    }
+
+    /// bring the entry of \a key up to date with \a m, writing any
+    /// change to its drawing to \a changes
+    void refresh(const Minsky& m, const Key& key, ostream& changes);
+    /// re-examine the dirty items, writing the changes of each kind
+    /// of item to \a changes
+    void refreshDirty(const Minsky& m, ostringstream changes[]);
+    /// mark every item of \a m, and every entry, dirty
+    void touchAll(const Minsky& m);
+  };
+}
+
+namespace
+{
+  const char* kindNames[]={"groupItem","var","op","wire","plot","godley"};
+
+  template <class C>
+  typename C::const_iterator findItem(const C& items, const string& id)
+  {return items.find(atoi(id.c_str()));}
+
+  /// the object of item \a id of kind \a kind in \a m, or NULL if
+  /// there is none, filling in \a s with the state of its drawing,
+  /// mirroring which items updateCanvas draws
+  const void* itemState(const Minsky& m, ChangeJournal::Kind kind, 
+                        const string& id, ItemState& s)
+  {
+    switch (kind)
+      {
+      case ChangeJournal::groupItem:
+        {
+          GroupIcons::const_iterator g=findItem(m.groupItems, id);
+          if (g==m.groupItems.end()) return NULL;
+          const GroupIcon& gi=g->second;
+          s.drawn=gi.visible && gi.group()==-1;
+          if (s.drawn)
+            s << gi.x() << gi.y() << gi.width << gi.height << gi.rotation 
+              << gi.zoomFactor << gi.displayContents() 
+              << gi.variables().size() << gi.operations().size() 
+              << gi.groups().size() << gi.numPorts();
+          return &gi;
+        }
+      case ChangeJournal::var:
+        {
+          VariableManager::const_iterator v=findItem(m.variables, id);
+          if (v==m.variables.end()) return NULL;
+          const VariableBase& vb=*v->second;
+          s.drawn=vb.visible && !vb.m_godley && vb.group==-1;
+          if (s.drawn)
+            s << vb.x() << vb.y() << vb.rotation << vb.zoomFactor 
+              << vb.type() << vb.Name();
+          return &vb;
+        }
+      case ChangeJournal::op:
+        {
+          Operations::const_iterator o=findItem(m.operations, id);
+          if (o==m.operations.end()) return NULL;
+          const OperationBase& op=*o->second;
+          s.drawn=op.visible && op.group==-1;
+          if (s.drawn)
+            {
+              s << op.x() << op.y() << op.rotation << op.zoomFactor 
+                << op.type() << op.ports().size();
+              if (const Constant* c=dynamic_cast<const Constant*>(&op))
+                s << c->value << c->sliderVisible << c->description;
+              else if (const IntOp* i=dynamic_cast<const IntOp*>(&op))
+                s << i->coupled() << i->getDescription();
+            }
+          return &op;
+        }
+      case ChangeJournal::wire:
+        {
+          PortManager::Wires::const_iterator w=findItem(m.wires, id);
+          if (w==m.wires.end()) return NULL;
+          s.drawn=w->second.visible;
+          if (s.drawn)
+            {
+              array<float> coords=w->second.Coords();
+              for (size_t i=0; i<coords.size(); ++i)
+                s << coords[i];
+            }
+          return &w->second;
+        }
+      case ChangeJournal::plot:
+        {
+          Plots::Map::const_iterator p=m.plots.plots.find(id);
+          if (p==m.plots.plots.end()) return NULL;
+          s.drawn=true;
+          s << p->second.x() << p->second.y() << p->second.zoomFactor;
+          return &p->second;
+        }
+      case ChangeJournal::godley:
+        {
+          Minsky::GodleyItems::const_iterator g=findItem(m.godleyItems, id);
+          if (g==m.godleyItems.end()) return NULL;
+          s.drawn=true;
+          s << g->second.x() << g->second.y() << g->second.zoomFactor
+            << g->second.flowVars.size() << g->second.stockVars.size();
+          return &g->second;
+        }
+      default:
+        return NULL;
+      }
+  }
+
+  template <class C>
+  void touchItems(set<CanvasState::Key>& dirty, ChangeJournal::Kind kind, 
+                  const C& items)
+  {
+    for (typename C::const_iterator i=items.begin(); i!=items.end(); ++i)
+      dirty.insert(CanvasState::Key(kind, str(i->first)));
+  }
+}
+
+void CanvasState::refresh(const Minsky& m, const Key& key, ostream& changes)
+{
+  Entries& kindEntries=entries[key.first];
+  Entries::iterator e=kindEntries.find(key.second);
+  ItemState s;
+  const void* object=itemState(m, key.first, key.second, s);
+
+  bool wasDrawn=e!=kindEntries.end() && e->second.state.drawn;
+  const char* change=NULL;
+  if (wasDrawn && !s.drawn)
+    change="deleted";
+  else if (!wasDrawn && s.drawn)
+    change="created";
+  else if (s.drawn && !(e->second.state==s))
+    change="modified";
+  if (change)
+    changes << change<<" "<<kindNames[key.first]<<" "<<key.second<<" ";
+
+  if (e!=kindEntries.end())
+    {
+      disown(e, key);
+      if (!object)
+        {
+          kindEntries.erase(e);
+          return;
+        }
+    }
+  else if (!object)
+    return;
+  else
+    e=kindEntries.insert(make_pair(key.second, Entry())).first;
+  e->second.state=s;
+  e->second.object=object;
+  owners[object]=key;
+}
+
+void CanvasState::refreshDirty(const Minsky& m, ostringstream changes[])
+{
+  // the wires within a group are placed relative to it. Groups come
+  // first in the set, so the wires added here are visited later on.
+  for (set<Key>::const_iterator i=dirty.begin(); i!=dirty.end(); ++i)
+    {
+      refresh(m, *i, changes[i->first]);
+      if (i->first==ChangeJournal::groupItem)
+        {
+          GroupIcons::const_iterator g=findItem(m.groupItems, i->second);
+          if (g==m.groupItems.end()) continue;
+          const vector<int>& w=g->second.wires();
+          for (size_t j=0; j<w.size(); ++j)
+            dirty.insert(Key(ChangeJournal::wire, str(w[j])));
+        }
+    }
+  dirty.clear();
+}
+
+void CanvasState::touchAll(const Minsky& m)
+{
+  for (int k=0; k<ChangeJournal::numKinds; ++k)
+    for (Entries::const_iterator e=entries[k].begin(); 
+         e!=entries[k].end(); ++e)
+      dirty.insert(Key(Kind(k), e->first));
+  touchItems(dirty, ChangeJournal::groupItem, m.groupItems);
+  touchItems(dirty, ChangeJournal::var, m.variables);
+  touchItems(dirty, ChangeJournal::op, m.operations);
+  touchItems(dirty, ChangeJournal::wire, m.wires);
+  for (Plots::Map::const_iterator p=m.plots.plots.begin(); 
+       p!=m.plots.plots.end(); ++p)
+    dirty.insert(Key(ChangeJournal::plot, p->first));
+  touchItems(dirty, ChangeJournal::godley, m.godleyItems);
+}
+
+void ChangeJournal::copy(const ChangeJournal&)
+{
+  // the journal refers to the objects of the model it was drained
+  // from, so a copy starts afresh
+  state.reset();
+}
+
+void ChangeJournal::touched(Kind kind, const string& id)
+{
+  if (state) state->dirty.insert(CanvasState::Key(kind, id));
+}
+
+void ChangeJournal::touched(const void* object)
+{
+  if (!state) return;
+  map<const void*, CanvasState::Key>::const_iterator o=
+    state->owners.find(object);
+  if (o!=state->owners.end())
+    state->dirty.insert(o->second);
+}
+
+void ChangeJournal::invalidate()
+{
+  if (state) state->synced.invalidate();
+}
+
+string ChangeJournal::drain(const Minsky& m)
+{
+  if (!state) state.reset(new CanvasState);
+  CanvasState& s=*state;
+  ostringstream changes[numKinds];
+
+  if (s.synced.current(s.size()))
+    {
+      s.refreshDirty(m, changes);
+      s.synced.update(s.size());
+    }
+
+  // items added or deleted without being reported leave the count
+  // out of step, which, like invalidate(), calls for every item to
+  // be compared
+  size_t numItems=m.groupItems.size()+m.variables.size()+
+    m.operations.size()+m.wires.size()+m.plots.plots.size()+
+    m.godleyItems.size();
+  if (!s.synced.current(numItems))
+    {
+      s.touchAll(m);
+      s.refreshDirty(m, changes);
+      s.synced.update(numItems);
+    }
+  s.dirty.clear();
+
+  string r;
+  for (int k=0; k<numKinds; ++k)
+    r+=changes[k].str();
+  return r;
+}
@@ -0,0 +1,86 @@
+/*
+  @copyright Steve Keen 2013
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+   @file record of the canvas items created, modified or deleted since
+   the canvas was last brought up to date, so that only those items
+   need to be redrawn
+*/
+#ifndef CHANGEJOURNAL_H
+#define CHANGEJOURNAL_H
+
+#include <TCL_obj_base.h>
+#include <string>
+
+namespace minsky
+{
+  using namespace std;
+  class Minsky;
+  struct CanvasState; // state of the canvas items as last drained
+
+  /**
+     Record of the canvas items changed since the canvas was last
+     brought up to date. The mutators of items, and the TCL proxies
+     through which they are edited, report the items they change with
+     touched(), as they do to the SceneIndex, and a drain re-examines
+     only those. The attributes each item was last drawn from are
+     kept, so that an item touched without visible effect is not
+     reported. Changes affecting every item, such as zooming or
+     loading a model, call invalidate() instead, as do changes in the
+     number of items not reported through touched().
+  */
+  class ChangeJournal
+  {
+    CLASSDESC_ACCESS(ChangeJournal);
+    classdesc::shared_ptr<CanvasState> state;
+    void copy(const ChangeJournal&);
+  public:
+    /// kinds of canvas item, in the order they are redrawn. Groups
+    /// come first, as drawing them moves the ports other items
+    /// attach to.
+    enum Kind {groupItem, var, op, wire, plot, godley, numKinds};
+
+    ChangeJournal() {}
+    ChangeJournal(const ChangeJournal& x) {copy(x);}
+    ChangeJournal& operator=(const ChangeJournal& x) {copy(x); return *this;}
+
+    /// item \a id of kind \a kind has been added, changed or deleted
+    void touched(Kind kind, const string& id);
+    /// the item at \a object (a VariableBase, OperationBase,
+    /// GroupIcon, Wire, PlotWidget or GodleyIcon) has changed. Does
+    /// nothing if it has not been drained, as new items are reported
+    /// by id
+    void touched(const void* object);
+    /// re-examine every item at the next drain
+    void invalidate();
+    /// return the changes to the canvas items of \a m since the last
+    /// call, and start a new journal. The changes are a TCL list of
+    /// triples {change kind id}, where change is one of created,
+    /// modified or deleted, and kind is the canvas tag prefix of the
+    /// item (groupItem, var, op, wire, plot or godley), in the order
+    /// of Kind.
+    string drain(const Minsky& m);
+    /// forget all recorded state, so the next drain reports every
+    /// item of the model as created
+    void clear() {state.reset();}
+  };
+}
+
+#include "changeJournal.cd"
+#endif
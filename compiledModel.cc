@@ -0,0 +1,458 @@
+/*
+  @copyright Steve Keen 2013
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "compiledModel.h"
+#include "minsky.h"
+#include <ecolab_epilogue.h>
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstdio>
+#include <stdint.h>
+#include <math.h>
+
+#ifndef WIN32
+#include <dlfcn.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#endif
+
+using namespace std;
+
+namespace minsky
+{
+  namespace
+  {
+    inline bool isFinite(const vector<double>& x)
+    {
+      for (size_t i=0; i<x.size(); ++i)
+        if (!finite(x[i])) return false;
+      return true;
+    }
+
+    /// text of an operand \a x of instruction \a i of the tape. \a
+    /// flowArr and \a stockArr name the arrays the operand is drawn
+    /// from, according to the source bit
+    string operand(const EvalTape& tape, size_t i, int x,
+                   const char* flowArr, const char* stockArr)
+    {
+      ostringstream o;
+      if (x==1)
+        o<<((tape.flags[i]&EvalTape::flow1Bit)? flowArr: stockArr)
+         <<"["<<tape.in1[i]<<"]";
+      else
+        o<<((tape.flags[i]&EvalTape::flow2Bit)? flowArr: stockArr)
+         <<"["<<tape.in2[i]<<"]";
+      return o.str();
+    }
+
+    string evalExpr(int op, const string& x1, const string& x2, int param)
+    {
+      ostringstream o;
+      switch (op)
+        {
+        case OperationType::constant: o<<"p["<<param<<"]"; break;
+        case OperationType::time: o<<"t"; break;
+        case OperationType::copy: o<<x1; break;
+        case OperationType::sqrt: o<<"sqrt("<<x1<<")"; break;
+        case OperationType::exp: o<<"exp("<<x1<<")"; break;
+        case OperationType::ln: o<<"log("<<x1<<")"; break;
+        case OperationType::log: o<<"log("<<x1<<")/log("<<x2<<")"; break;
+        case OperationType::pow: o<<"pow("<<x1<<","<<x2<<")"; break;
+        case OperationType::sin: o<<"sin("<<x1<<")"; break;
+        case OperationType::cos: o<<"cos("<<x1<<")"; break;
+        case OperationType::tan: o<<"tan("<<x1<<")"; break;
+        case OperationType::asin: o<<"asin("<<x1<<")"; break;
+        case OperationType::acos: o<<"acos("<<x1<<")"; break;
+        case OperationType::atan: o<<"atan("<<x1<<")"; break;
+        case OperationType::sinh: o<<"sinh("<<x1<<")"; break;
+        case OperationType::cosh: o<<"cosh("<<x1<<")"; break;
+        case OperationType::tanh: o<<"tanh("<<x1<<")"; break;
+        case OperationType::add: o<<x1<<"+"<<x2; break;
+        case OperationType::subtract: o<<x1<<"-"<<x2; break;
+        case OperationType::multiply: o<<x1<<"*"<<x2; break;
+        case OperationType::divide: o<<x1<<"/"<<x2; break;
+        default:
+          throw error("cannot generate code for %s",
+                      OperationType::typeName(op).c_str());
+        }
+      return o.str();
+    }
+
+    /// derivative with respect to first argument (mirrors EvalOp::d1)
+    string d1Expr(int op, const string& x1, const string& x2)
+    {
+      switch (op)
+        {
+        case OperationType::copy: return "1";
+        case OperationType::sqrt: return "0.5/sqrt("+x1+")";
+        case OperationType::exp: return "exp("+x1+")";
+        case OperationType::ln: return "1/"+x1;
+        case OperationType::log: return "1/("+x1+"*log("+x2+"))";
+        case OperationType::pow: return "pow("+x1+","+x2+")*"+x2+"/"+x1;
+        case OperationType::sin: return "cos("+x1+")";
+        case OperationType::cos: return "-sin("+x1+")";
+        case OperationType::tan: return "1/(cos("+x1+")*cos("+x1+"))";
+        case OperationType::asin: return "1/sqrt(1-"+x1+"*"+x1+")";
+        case OperationType::acos: return "-1/sqrt(1-"+x1+"*"+x1+")";
+        case OperationType::atan: return "1/(1+"+x1+"*"+x1+")";
+        case OperationType::sinh: return "cosh("+x1+")";
+        case OperationType::cosh: return "sinh("+x1+")";
+        case OperationType::tanh: return "1/(cosh("+x1+")*cosh("+x1+"))";
+        case OperationType::add: case OperationType::subtract: return "1";
+        case OperationType::multiply: return x2;
+        case OperationType::divide: return "1/"+x2;
+        default: return "0";
+        }
+    }
+
+    /// derivative with respect to second argument (mirrors EvalOp::d2)
+    string d2Expr(int op, const string& x1, const string& x2)
+    {
+      switch (op)
+        {
+        case OperationType::log:
+          return "-log("+x1+")/("+x2+"*log("+x2+")*log("+x2+"))";
+        case OperationType::pow: return "pow("+x1+","+x2+")*log("+x1+")";
+        case OperationType::add: return "1";
+        case OperationType::subtract: return "-1";
+        case OperationType::multiply: return x1;
+        case OperationType::divide: return "-"+x1+"/("+x2+"*"+x2+")";
+        default: return "0";
+        }
+    }
+
+    /// emit the Godley table accumulation (mirrors GodleyIncidence::apply)
+    void emitGodley(ostream& o, const Minsky& m, const char* fv,
+                    const char* result)
+    {
+      const GodleyIncidence& g=m.godleyIncidence;
+      for (size_t s=0; s+1<g.rowStart.size(); ++s)
+        {
+          if (g.rowStart[s]==g.rowStart[s+1]) continue;
+          o<<"  "<<result<<"["<<s<<"]+=";
+          for (int p=g.rowStart[s]; p<g.rowStart[s+1]; ++p)
+            {
+              if (p>g.rowStart[s]) o<<"+";
+              if (g.coef[p]!=1)
+                o<<"("<<setprecision(17)<<g.coef[p]<<")*";
+              o<<fv<<"["<<g.flow[p]<<"]";
+            }
+          o<<";\n";
+        }
+    }
+
+    /// emit the integral assignments
+    void emitIntegrals(ostream& o, const Minsky& m, const char* fv,
+                       const char* sv, const char* result)
+    {
+      for (vector<Integral>::const_iterator i=m.integrals.begin();
+           i!=m.integrals.end(); ++i)
+        {
+          if (i->input.idx()<0)
+            {
+              if (i->operation)
+                Minsky::displayErrorItem(i->operation->x(), i->operation->y());
+              throw error("integral not wired");
+            }
+          o<<"  "<<result<<"["<<i->stock.idx()<<"]="
+           <<(i->input.lhs()? fv: sv)<<"["<<i->input.idx()<<"];\n";
+        }
+    }
+
+    /// 64 bit FNV-1a hash, used to name cached objects
+    uint64_t hash(const string& s)
+    {
+      uint64_t h=14695981039346656037ULL;
+      for (size_t i=0; i<s.size(); ++i)
+        {
+          h^=(unsigned char)s[i];
+          h*=1099511628211ULL;
+        }
+      return h;
+    }
+
+    /// returns true if file \a name has contents \a contents
+    bool sameContents(const string& name, const string& contents)
+    {
+      ifstream f(name.c_str());
+      if (!f) return false;
+      ostringstream s;
+      s<<f.rdbuf();
+      return s.str()==contents;
+    }
+
+    /// returns true if file \a name exists
+    bool exists(const string& name)
+    {
+      ifstream f(name.c_str());
+      return f.good();
+    }
+
+#ifndef WIN32
+    /// quote \a s as a single shell word
+    string shellQuote(const string& s)
+    {
+      string r="'";
+      for (size_t i=0; i<s.size(); ++i)
+        if (s[i]=='\'')
+          r+="'\\''";
+        else
+          r+=s[i];
+      return r+"'";
+    }
+
+    /// true if \a dir is a directory (not a link to one), owned by
+    /// this user and inaccessible to anyone else
+    bool isPrivateDir(const string& dir)
+    {
+      struct stat s;
+      return lstat(dir.c_str(), &s)==0 && S_ISDIR(s.st_mode) &&
+        s.st_uid==geteuid() && (s.st_mode&077)==0;
+    }
+
+    pthread_mutex_t cacheDirMutex=PTHREAD_MUTEX_INITIALIZER;
+    struct CacheDirLock
+    {
+      CacheDirLock() {pthread_mutex_lock(&cacheDirMutex);}
+      ~CacheDirLock() {pthread_mutex_unlock(&cacheDirMutex);}
+    };
+
+    /// directory in which compiled models are cached. Objects are
+    /// loaded from here, so it must be private to this user.
+    /// $TMPDIR/minsky-<uid> is reused between runs, but if that name is
+    /// held by anything other than a private directory of ours, a fresh
+    /// directory is created with mkdtemp instead
+    string cacheDir()
+    {
+      CacheDirLock lock;
+      static string dir;
+      if (!dir.empty() && isPrivateDir(dir))
+        return dir;
+
+      const char* tmpdir=getenv("TMPDIR");
+      string base=string(tmpdir && *tmpdir? tmpdir: "/tmp")+"/minsky-";
+      ostringstream userDir;
+      userDir<<base<<geteuid();
+      dir=userDir.str();
+      if (mkdir(dir.c_str(), 0700)==0 || isPrivateDir(dir))
+        return dir;
+
+      string templ=base+"XXXXXX";
+      vector<char> buf(templ.begin(), templ.end());
+      buf.push_back('\0');
+      if (!mkdtemp(&buf[0]) || !isPrivateDir(&buf[0]))
+        {
+          dir.clear();
+          throw error("unable to create a private directory in %s",
+                      tmpdir? tmpdir: "/tmp");
+        }
+      dir=&buf[0];
+      return dir;
+    }
+#endif
+  }
+
+  string CompiledModel::generate(const Minsky& m)
+  {
+    const EvalTape& tape=m.tape;
+    size_t nStocks=m.stockVars.size();
+    ostringstream o;
+    o<<"// generated by Minsky - do not edit\n";
+    o<<"#include <math.h>\n";
+    o<<"extern \"C\" {\n";
+
+    // right hand side
+    o<<"void minsky_rhs(double t, const double sv[], double fv[], "
+      "double result[], const double p[])\n{\n";
+    for (size_t i=0; i<tape.size(); ++i)
+      o<<"  fv["<<tape.out[i]<<"]="
+       <<evalExpr(tape.opcode[i], operand(tape,i,1,"fv","sv"),
+                  operand(tape,i,2,"fv","sv"), tape.param[i])<<";\n";
+    o<<"  for (int i=0; i<"<<nStocks<<"; ++i) result[i]=0;\n";
+    emitGodley(o, m, "fv", "result");
+    emitIntegrals(o, m, "fv", "sv", "result");
+    o<<"}\n\n";
+
+    // directional derivative, one column of the Jacobian
+    o<<"void minsky_tangent(const double sv[], const double fv[], "
+      "const double ds[], double df[], double d[], const double p[])\n{\n";
+    o<<"  double dx1, dx2;\n";
+    for (size_t i=0; i<tape.size(); ++i)
+      {
+        int op=tape.opcode[i];
+        string x1=operand(tape,i,1,"fv","sv"), x2=operand(tape,i,2,"fv","sv");
+        switch (EvalOpPtr(OperationType::Type(op))->numArgs())
+          {
+          case 0:
+            o<<"  df["<<tape.out[i]<<"]=0;\n";
+            break;
+          case 1:
+            o<<"  dx1="<<operand(tape,i,1,"df","ds")<<";\n";
+            o<<"  df["<<tape.out[i]<<"]=dx1!=0? dx1*("<<d1Expr(op,x1,x2)
+             <<"): 0;\n";
+            break;
+          case 2:
+            o<<"  dx1="<<operand(tape,i,1,"df","ds")<<";\n";
+            o<<"  dx2="<<operand(tape,i,2,"df","ds")<<";\n";
+            o<<"  df["<<tape.out[i]<<"]=(dx1!=0? dx1*("<<d1Expr(op,x1,x2)
+             <<"): 0) + (dx2!=0? dx2*("<<d2Expr(op,x1,x2)<<"): 0);\n";
+            break;
+          }
+      }
+    o<<"  for (int i=0; i<"<<nStocks<<"; ++i) d[i]=0;\n";
+    emitGodley(o, m, "df", "d");
+    emitIntegrals(o, m, "df", "ds", "d");
+    o<<"}\n";
+
+    o<<"}\n";
+    return o.str();
+  }
+
+#ifdef WIN32
+  CompiledModel::CompiledModel(const Minsky& m): lib(NULL), rhs(NULL), tangent(NULL)
+  {
+    throw error("compiled model mode not supported on this platform");
+  }
+
+  CompiledModel::~CompiledModel() {}
+#else
+  CompiledModel::CompiledModel(const Minsky& m): lib(NULL), rhs(NULL), tangent(NULL)
+  {
+    source=generate(m);
+
+    // a cache entry is only ever written with the source stored
+    // beside it, so a library at a given path, including one dlopen
+    // has already loaded, always comes from that source. Should
+    // another model's source already be held under this hash, the
+    // next free suffix is used instead.
+    ostringstream hashName;
+    hashName<<cacheDir()<<"/model-"<<hex<<hash(source);
+    string base=hashName.str(), srcName=base+".cc";
+    for (unsigned n=1; exists(srcName) && !sameContents(srcName, source); ++n)
+      {
+        ostringstream suffixed;
+        suffixed<<hashName.str()<<"-"<<n;
+        base=suffixed.str();
+        srcName=base+".cc";
+      }
+    libName=base+".so";
+
+    // the source file is moved into place after the library, so its
+    // presence indicates a complete cache entry
+    if (!sameContents(srcName, source))
+      {
+        ostringstream tmp;
+        tmp<<base<<"-tmp"<<getpid();
+        string tmpSrc=tmp.str()+".cc", tmpLib=tmp.str()+".so";
+        {
+          ofstream f(tmpSrc.c_str());
+          f<<source;
+          if (!f)
+            throw error("unable to write %s", tmpSrc.c_str());
+        }
+        // CXX names the compiler executable
+        const char* cxx=getenv("CXX");
+        string cmd=shellQuote(cxx && *cxx? cxx: "c++")+
+          " -O2 -shared -fPIC -o "+shellQuote(tmpLib)+" "+shellQuote(tmpSrc);
+        int status=system(cmd.c_str());
+        if (status==-1 || !WIFEXITED(status) || WEXITSTATUS(status)!=0)
+          {
+            remove(tmpSrc.c_str());
+            remove(tmpLib.c_str());
+            throw error("compiling model failed (status %d): %s",
+                        status, cmd.c_str());
+          }
+        if (rename(tmpLib.c_str(), libName.c_str())!=0 ||
+            rename(tmpSrc.c_str(), srcName.c_str())!=0)
+          throw error("unable to cache compiled model %s", libName.c_str());
+      }
+
+    lib=dlopen(libName.c_str(), RTLD_NOW|RTLD_LOCAL);
+    if (!lib)
+      throw error("unable to load %s: %s", libName.c_str(), dlerror());
+    rhs=(Rhs)dlsym(lib, "minsky_rhs");
+    tangent=(Tangent)dlsym(lib, "minsky_tangent");
+    if (!rhs || !tangent)
+      {
+        dlclose(lib);
+        throw error("invalid compiled model %s", libName.c_str());
+      }
+  }
+
+  CompiledModel::~CompiledModel()
+  {
+    if (lib) dlclose(lib);
+  }
+#endif
+
+  void CompiledModel::loadParams(const Minsky& m)
+  {
+    const vector<OperationPtr>& c=m.tape.constants;
+    params.resize(c.size()+1);
+    for (size_t i=0; i<c.size(); ++i)
+      params[i]=static_cast<const Constant&>(*c[i]).value;
+  }
+
+  void CompiledModel::evalEquations
+  (Minsky& m, double result[], const double sv[])
+  {
+    loadParams(m);
+    flow=m.flowVars;
+    if (flow.empty()) flow.resize(1);
+    rhs(m.t, sv, &flow[0], result, &params[0]);
+    if (!isFinite(flow))
+      // fall back to the interpreter, which reports the offending operation
+      m.evalEquations(result, sv);
+  }
+
+  void CompiledModel::jacobian(Minsky& m, MinskyMatrix& jac, const double sv[])
+  {
+    size_t nStocks=m.stockVars.size();
+    loadParams(m);
+    flow=m.flowVars;
+    if (flow.empty()) flow.resize(1);
+    d.resize(nStocks);
+    rhs(m.t, sv, &flow[0], &d[0], &params[0]);
+    if (!isFinite(flow))
+      {
+        m.jacobian(jac, sv);
+        return;
+      }
+
+    ds.assign(nStocks, 0);
+    for (size_t j=0; j<nStocks; ++j)
+      {
+        ds[j]=1;
+        df.assign(flow.size(), 0);
+        tangent(sv, &flow[0], &ds[0], &df[0], &d[0], &params[0]);
+        if (!isFinite(df))
+          {
+            m.jacobian(jac, sv);
+            return;
+          }
+        for (size_t i=0; i<nStocks; i++)
+          jac(i,j)=d[i];
+        ds[j]=0;
+      }
+  }
+}
@@ -0,0 +1,79 @@
+/*
+  @copyright Steve Keen 2013
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+   @file native code version of the equation system. The equation
+   tape, Godley tables and integrals are emitted as straight line C++
+   code with fixed array indices, compiled into a shared object by the
+   system compiler and loaded with dlopen.
+*/
+#ifndef COMPILEDMODEL_H
+#define COMPILEDMODEL_H
+
+#include <string>
+#include <vector>
+
+namespace minsky
+{
+  class Minsky;
+  class MinskyMatrix;
+
+  class CompiledModel
+  {
+  public:
+    /// signatures of the generated functions
+    typedef void (*Rhs)(double t, const double sv[], double fv[],
+                        double result[], const double params[]);
+    typedef void (*Tangent)(const double sv[], const double fv[],
+                            const double ds[], double df[], double d[],
+                            const double params[]);
+  private:
+    void* lib;
+    Rhs rhs;
+    Tangent tangent;
+    /// current constant values, passed to the generated code
+    std::vector<double> params;
+    /// scratch buffers
+    std::vector<double> flow, ds, df, d;
+
+    void loadParams(const Minsky&);
+    // not copyable, as we own the library handle
+    CompiledModel(const CompiledModel&);
+    void operator=(const CompiledModel&);
+  public:
+    std::string source; ///< generated code
+    std::string libName; ///< shared object the code was loaded from
+
+    /// generate, compile (if not already cached) and load code for
+    /// the current equations of \a m
+    /// @throws ecolab::error if compilation or loading fails
+    CompiledModel(const Minsky& m);
+    ~CompiledModel();
+
+    /// generate the source code for \a m
+    static std::string generate(const Minsky& m);
+
+    /// native code equivalents of Minsky::evalEquations and
+    /// Minsky::jacobian
+    void evalEquations(Minsky& m, double result[], const double sv[]);
+    void jacobian(Minsky& m, MinskyMatrix& jac, const double sv[]);
+  };
+}
+
+#endif
@@ -0,0 +1,126 @@
+/*
+  @copyright Steve Keen 2013
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "ensemble.h"
+#include <ecolab_epilogue.h>
+
+namespace minsky
+{
+  namespace
+  {
+    /// spread each value of \a x over \a nLanes lanes of \a r
+    void broadcast(vector<double>& r, const vector<double>& x, size_t nLanes)
+    {
+      r.resize(x.size()*nLanes);
+      for (size_t i=0; i<x.size(); ++i)
+        for (size_t k=0; k<nLanes; ++k)
+          r[i*nLanes+k]=x[i];
+    }
+  }
+
+  void Ensemble::init(const EvalTape& tape, const GodleyIncidence& godley,
+                      const vector<double>& sv, const vector<double>& fv,
+                      size_t nLanes, double t0)
+  {
+    if (nLanes<1)
+      throw error("ensemble needs at least one lane");
+    this->tape=tape;
+    this->godley=godley;
+    this->nLanes=nLanes;
+    t=t0;
+    integralStock.clear();
+    integralInput.clear();
+    integralInputFlow.clear();
+
+    broadcast(stocks, sv, nLanes);
+    broadcast(flowInit, fv, nLanes);
+    flows=flowInit;
+    vector<double> constantValues;
+    for (size_t c=0; c<tape.constants.size(); ++c)
+      constantValues.push_back
+        (static_cast<const Constant&>(*tape.constants[c]).value);
+    broadcast(params, constantValues, nLanes);
+
+    k1.resize(stocks.size());
+    k2.resize(stocks.size());
+    k3.resize(stocks.size());
+    k4.resize(stocks.size());
+    y.resize(stocks.size());
+  }
+
+  void Ensemble::addIntegral(int stock, int input, bool inputIsFlow)
+  {
+    integralStock.push_back(stock);
+    integralInput.push_back(input);
+    integralInputFlow.push_back(inputIsFlow);
+  }
+
+  void Ensemble::setParameter(const OperationPtr& c, size_t lane, double value)
+  {
+    if (lane>=nLanes)
+      throw error("lane %d out of range", int(lane));
+    for (size_t i=0; i<tape.constants.size(); ++i)
+      if (tape.constants[i]==c)
+        {
+          params[i*nLanes+lane]=value;
+          return;
+        }
+    throw error("not a constant of the ensemble equations");
+  }
+
+  void Ensemble::derivative(double dsdt[], const double sv[], double t)
+  {
+    flows=flowInit;
+    int bad=tape.evalLanes(&flows[0], sv, t, nLanes,
+                            params.empty()? NULL: &params[0]);
+    if (bad>=0)
+      throw error("Invalid: %s in ensemble",
+                  OperationType::typeName(tape.opcode[bad]).c_str());
+
+    for (size_t i=0; i<stocks.size(); ++i) dsdt[i]=0;
+    godley.applyLanes(dsdt, &flows[0], nLanes);
+    for (size_t i=0; i<integralStock.size(); ++i)
+      {
+        double* r=dsdt+integralStock[i]*nLanes;
+        const double* x=(integralInputFlow[i]? &flows[0]: sv)+
+          integralInput[i]*nLanes;
+        for (size_t k=0; k<nLanes; ++k) r[k]=x[k];
+      }
+  }
+
+  void Ensemble::step(double dt, int nSteps)
+  {
+    size_t n=stocks.size();
+    if (n==0) return;
+    for (int s=0; s<nSteps; ++s)
+      {
+        derivative(&k1[0], &stocks[0], t);
+        for (size_t i=0; i<n; ++i) y[i]=stocks[i]+0.5*dt*k1[i];
+        derivative(&k2[0], &y[0], t+0.5*dt);
+        for (size_t i=0; i<n; ++i) y[i]=stocks[i]+0.5*dt*k2[i];
+        derivative(&k3[0], &y[0], t+0.5*dt);
+        for (size_t i=0; i<n; ++i) y[i]=stocks[i]+dt*k3[i];
+        derivative(&k4[0], &y[0], t+dt);
+        for (size_t i=0; i<n; ++i)
+          stocks[i]+=dt/6*(k1[i]+2*k2[i]+2*k3[i]+k4[i]);
+        t+=dt;
+      }
+    // leave the flow variables consistent with the final stocks
+    derivative(&k1[0], &stocks[0], t);
+  }
+}
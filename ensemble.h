@@ -0,0 +1,88 @@
+/*
+  @copyright Steve Keen 2013
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include "evalTape.h"
+#include "godleyIncidence.h"
+#include "classdesc_access.h"
+#include <vector>
+
+namespace minsky
+{
+  using namespace std;
+
+  /**
+     A number of variants of the model, differing in the values of
+     their Constant operations, integrated together in lock step. Each
+     stock and flow variable holds nLanes consecutive values, one per
+     variant, so that each operation of the equation tape is applied
+     to all variants in a single loop.
+  */
+  class Ensemble
+  {
+    CLASSDESC_ACCESS(Ensemble);
+    EvalTape tape;
+    GodleyIncidence godley;
+    /// stock index, input index and whether the input is a flow
+    /// variable, of each integral
+    vector<int> integralStock, integralInput;
+    vector<bool> integralInputFlow;
+    /// initial flow variables, to which flow variables are reset
+    /// before each evaluation
+    vector<double> flowInit;
+    /// lane values of each constant of tape.constants
+    vector<double> params;
+    /// Runge-Kutta stages
+    vector<double> k1, k2, k3, k4, y;
+
+    /// time derivative of stock variables \a sv at time \a t
+    void derivative(double dsdt[], const double sv[], double t);
+  public:
+    size_t nLanes;
+    double t; ///< time
+    /// stock and flow variables, lane k of variable i at i*nLanes+k
+    vector<double> stocks, flows;
+
+    Ensemble(): nLanes(0), t(0) {}
+
+    /// set up \a nLanes copies of the equations \a tape and \a godley,
+    /// starting at time \a t0 from stock variables \a sv and flow
+    /// variables \a fv. All lanes start with the current Constant values
+    void init(const EvalTape& tape, const GodleyIncidence& godley,
+              const vector<double>& sv, const vector<double>& fv,
+              size_t nLanes, double t0=0);
+    /// add an integral, whose derivative is given by \a input
+    void addIntegral(int stock, int input, bool inputIsFlow);
+    /// set the value of the Constant operation \a c in \a lane
+    /// @throws ecolab::error if \a c is not a constant of the equations
+    void setParameter(const OperationPtr& c, size_t lane, double value);
+
+    /// advance all lanes by \a nSteps fourth order Runge-Kutta steps
+    /// of size \a dt
+    /// @throws ecolab::error if any lane produces a non-finite value
+    void step(double dt, int nSteps=1);
+
+    double stock(size_t i, size_t lane) const {return stocks[i*nLanes+lane];}
+    double flow(size_t i, size_t lane) const {return flows[i*nLanes+lane];}
+  };
+}
+
+#include "ensemble.cd"
+#endif
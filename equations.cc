@@ -741,7 +741,8 @@ namespace MathDAG
         PortManager::Ports::const_iterator p=pm.ports.find(op.ports()[i]);
         if (p != pm.ports.end() && p->second.input)
           {
-            array<int> wires=pm.WiresAttachedToPort(op.ports()[i]);
+            const PortManager::WireIds& wires=
+              pm.WiresAttachedToPort(op.ports()[i]);
             for (int w=0; w<wires.size(); ++w)
               r->arguments[i-1].push_back
                 (shared_ptr<Node>(createNodeFromWire(wires[w])));
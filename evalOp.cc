@@ -39,7 +39,7 @@ namespace minsky
   void EvalOpBase::reset()
   {
     if (Constant* c=dynamic_cast<Constant*>(state.get()))
-      ValueVector::flowVars[out]=c->value;
+      valueVector().flowVars[out]=c->value;
   }
 
   template <> int EvalOp<OperationType::constant>::numArgs() const {return 0;}
@@ -69,6 +69,8 @@ namespace minsky
 
   void EvalOpBase::eval(double fv[], const double sv[])
   {
+    if (!fv) fv=&valueVector().flowVars[0];
+    if (!sv) sv=&valueVector().stockVars[0];
     fv[out]=evaluate(flow1? fv[in1]: sv[in1], flow2? fv[in2]: sv[in2]);
     if (!finite(fv[out]))
       {
@@ -86,7 +88,7 @@ namespace minsky
   void EvalOpBase::deriv(double df[], const double ds[], 
                      const double sv[], const double fv[])
   {
-    assert(out>=0 && out<ValueVector::flowVars.size());
+    assert(out>=0 && out<valueVector().flowVars.size());
     switch (numArgs()) 
       {
       case 0:
@@ -94,7 +96,7 @@ namespace minsky
         return;
       case 1:
         {
-          assert(flow1 && in1<ValueVector::flowVars.size() || !flow1&&in1<ValueVector::stockVars.size());
+          assert(flow1 && in1<valueVector().flowVars.size() || !flow1&&in1<valueVector().stockVars.size());
           double x1=flow1? fv[in1]: sv[in1];
           double dx1=flow1? df[in1]: ds[in1];
           df[out] = dx1!=0? dx1 * d1(x1,0): 0;
@@ -102,8 +104,8 @@ namespace minsky
         }
       case 2:
         {
-          assert(flow1 && in1<ValueVector::flowVars.size() || !flow1&&in1<ValueVector::stockVars.size());
-          assert(flow2 && in2<ValueVector::flowVars.size() || !flow2&&in2<ValueVector::stockVars.size());
+          assert(flow1 && in1<valueVector().flowVars.size() || !flow1&&in1<valueVector().stockVars.size());
+          assert(flow2 && in2<valueVector().flowVars.size() || !flow2&&in2<valueVector().stockVars.size());
           double x1=flow1? fv[in1]: sv[in1];
           double x2=flow2? fv[in2]: sv[in2];
           double dx1=flow1? df[in1]: ds[in1];
@@ -70,9 +70,9 @@ namespace minsky
     /// number of arguments to this operation
     virtual int numArgs() const =0;
     /// evaluate expression on sv and current value of fv, storing result
-    /// in output variable (of \a fv)
-    void eval(double fv[]=&ValueVector::flowVars[0], 
-              const double sv[]=&ValueVector::stockVars[0]);
+    /// in output variable (of \a fv). These default to the variables of
+    /// valueVector()
+    void eval(double fv[]=NULL, const double sv[]=NULL);
  
     /// evaluate expression on given arguments, returning result
     virtual double evaluate(double in1=0, double in2=0) const=0;
@@ -0,0 +1,528 @@
+/*
+  @copyright Steve Keen 2013
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "evalTape.h"
+#include <ecolab_epilogue.h>
+
+#include <math.h>
+
+namespace minsky
+{
+  namespace
+  {
+    inline double sqr(double x) {return x*x;}
+
+    /// partial derivatives \a d1, \a d2 of operation \a op with
+    /// respect to its arguments, as given by EvalOp<op>::d1 and d2
+    inline void partials(int op, double x1, double x2, double& d1, double& d2)
+    {
+      d2=0;
+      switch (op)
+        {
+        case OperationType::copy: d1=1; break;
+        case OperationType::sqrt: d1=0.5/::sqrt(x1); break;
+        case OperationType::exp: d1=::exp(x1); break;
+        case OperationType::ln: d1=1/x1; break;
+        case OperationType::log:
+          d1=1/(x1*::log(x2));
+          d2=-::log(x1)/(x2*sqr(::log(x2)));
+          break;
+        case OperationType::pow:
+          d1=::pow(x1,x2)*x2/x1;
+          d2=::pow(x1,x2)*::log(x1);
+          break;
+        case OperationType::sin: d1=::cos(x1); break;
+        case OperationType::cos: d1=-::sin(x1); break;
+        case OperationType::tan: d1=1/sqr(::cos(x1)); break;
+        case OperationType::asin: d1=1/::sqrt(1-sqr(x1)); break;
+        case OperationType::acos: d1=-1/::sqrt(1-sqr(x1)); break;
+        case OperationType::atan: d1=1/(1+sqr(x1)); break;
+        case OperationType::sinh: d1=::cosh(x1); break;
+        case OperationType::cosh: d1=::sinh(x1); break;
+        case OperationType::tanh: d1=1/sqr(::cosh(x1)); break;
+        case OperationType::add: d1=1; d2=1; break;
+        case OperationType::subtract: d1=1; d2=-1; break;
+        case OperationType::multiply: d1=x2; d2=x1; break;
+        case OperationType::divide: d1=1/x2; d2=-x1/(x2*x2); break;
+        default: d1=0; break;
+        }
+    }
+
+    /// value of operation \a op applied to \a x1 and \a x2, for all
+    /// but constant and time operations
+    inline double applyOp(int op, double x1, double x2)
+    {
+      switch (op)
+        {
+        case OperationType::copy: return x1;
+        case OperationType::sqrt: return ::sqrt(x1);
+        case OperationType::exp: return ::exp(x1);
+        case OperationType::ln: return ::log(x1);
+        case OperationType::log: return ::log(x1)/::log(x2);
+        case OperationType::pow: return ::pow(x1,x2);
+        case OperationType::sin: return ::sin(x1);
+        case OperationType::cos: return ::cos(x1);
+        case OperationType::tan: return ::tan(x1);
+        case OperationType::asin: return ::asin(x1);
+        case OperationType::acos: return ::acos(x1);
+        case OperationType::atan: return ::atan(x1);
+        case OperationType::sinh: return ::sinh(x1);
+        case OperationType::cosh: return ::cosh(x1);
+        case OperationType::tanh: return ::tanh(x1);
+        case OperationType::add: return x1+x2;
+        case OperationType::subtract: return x1-x2;
+        case OperationType::multiply: return x1*x2;
+        case OperationType::divide: return x1/x2;
+        default:
+          // compile() rejects anything else
+          assert(false);
+          return 0;
+        }
+    }
+  }
+
+  void EvalTape::clear()
+  {
+    opcode.clear();
+    out.clear(); in1.clear(); in2.clear();
+    flags.clear();
+    param.clear();
+    constants.clear();
+    source.clear();
+    levelStart.clear();
+  }
+
+  void EvalTape::compile(const vector<EvalOpPtr>& equations)
+  {
+    clear();
+    size_t n=equations.size();
+    opcode.reserve(n);
+    out.reserve(n); in1.reserve(n); in2.reserve(n);
+    flags.reserve(n);
+    param.reserve(n);
+    source.reserve(n);
+
+    for (size_t i=0; i<n; ++i)
+      {
+        const EvalOpBase& e=*equations[i];
+        switch (e.type())
+          {
+          case OperationType::integrate:
+          case OperationType::numOps:
+            throw error("cannot evaluate %s operation",
+                        OperationType::typeName(e.type()).c_str());
+          default:
+            break;
+          }
+
+        opcode.push_back(e.type());
+        out.push_back(e.out);
+        // unused operands are pointed at the output slot, so that
+        // the interpreter can load both operands unconditionally
+        unsigned char f=0;
+        int nArgs=e.numArgs();
+        if (nArgs>0)
+          {
+            in1.push_back(e.in1);
+            if (e.flow1) f|=flow1Bit;
+          }
+        else
+          {
+            in1.push_back(e.out);
+            f|=flow1Bit;
+          }
+        if (nArgs>1)
+          {
+            in2.push_back(e.in2);
+            if (e.flow2) f|=flow2Bit;
+          }
+        else
+          {
+            in2.push_back(e.out);
+            f|=flow2Bit;
+          }
+        flags.push_back(f);
+
+        if (e.type()==OperationType::constant &&
+            dynamic_cast<Constant*>(e.state.get()))
+          {
+            param.push_back(constants.size());
+            constants.push_back(e.state);
+          }
+        else
+          param.push_back(-1);
+        source.push_back(i);
+      }
+  }
+
+  int EvalTape::evalRange(double fv[], const double sv[], double t,
+                          size_t begin, size_t end) const
+  {
+    for (size_t i=begin; i<end; ++i)
+      {
+        double x1=(flags[i]&flow1Bit)? fv[in1[i]]: sv[in1[i]];
+        double x2=(flags[i]&flow2Bit)? fv[in2[i]]: sv[in2[i]];
+        double r;
+        switch (opcode[i])
+          {
+          case OperationType::constant:
+            r = param[i]>=0?
+              static_cast<const Constant&>(*constants[param[i]]).value: 0;
+            break;
+          case OperationType::time: r=t; break;
+          default: r=applyOp(opcode[i], x1, x2); break;
+          }
+        fv[out[i]]=r;
+        if (!finite(r)) return i;
+      }
+    return -1;
+  }
+
+  int EvalTape::evalLanes(double fv[], const double sv[], double t, 
+                          size_t nLanes, const double params[]) const
+  {
+    const size_t L=nLanes;
+    for (size_t i=0; i<size(); ++i)
+      {
+        double* r=fv+out[i]*L;
+        const double* x1=((flags[i]&flow1Bit)? fv: sv)+in1[i]*L;
+        const double* x2=((flags[i]&flow2Bit)? fv: sv)+in2[i]*L;
+        // dispatch once per instruction, with simple loops over the
+        // lanes that the compiler can vectorise
+        switch (opcode[i])
+          {
+          case OperationType::constant:
+            if (param[i]<0)
+              for (size_t k=0; k<L; ++k) r[k]=0;
+            else if (params)
+              for (size_t k=0; k<L; ++k) r[k]=params[param[i]*L+k];
+            else
+              {
+                double v=static_cast<const Constant&>
+                  (*constants[param[i]]).value;
+                for (size_t k=0; k<L; ++k) r[k]=v;
+              }
+            continue;
+          case OperationType::time: 
+            for (size_t k=0; k<L; ++k) r[k]=t; 
+            continue;
+          case OperationType::copy: 
+            for (size_t k=0; k<L; ++k) r[k]=x1[k]; 
+            break;
+          case OperationType::add: 
+            for (size_t k=0; k<L; ++k) r[k]=x1[k]+x2[k]; 
+            break;
+          case OperationType::subtract: 
+            for (size_t k=0; k<L; ++k) r[k]=x1[k]-x2[k]; 
+            break;
+          case OperationType::multiply: 
+            for (size_t k=0; k<L; ++k) r[k]=x1[k]*x2[k]; 
+            break;
+          case OperationType::divide: 
+            for (size_t k=0; k<L; ++k) r[k]=x1[k]/x2[k]; 
+            break;
+          default:
+            for (size_t k=0; k<L; ++k) r[k]=applyOp(opcode[i], x1[k], x2[k]);
+            break;
+          }
+        bool finiteResult=true;
+        for (size_t k=0; k<L; ++k) finiteResult &= finite(r[k]);
+        if (!finiteResult) return i;
+      }
+    return -1;
+  }
+
+  int EvalTape::deriv(double df[], const double ds[], const double sv[],
+                      const double fv[], const double dt[]) const
+  {
+    const size_t w=derivWidth;
+    size_t n=opcode.size();
+    for (size_t i=0; i<n; ++i)
+      {
+        double* r=df+out[i]*w;
+        switch (opcode[i])
+          {
+          case OperationType::constant:
+            for (size_t k=0; k<w; ++k) r[k]=0;
+            continue;
+          case OperationType::time:
+            for (size_t k=0; k<w; ++k) r[k]=dt? dt[k]: 0;
+            continue;
+          default:
+            break;
+          }
+
+        bool f1=flags[i]&flow1Bit, f2=flags[i]&flow2Bit;
+        double d1, d2;
+        partials(opcode[i], f1? fv[in1[i]]: sv[in1[i]],
+                 f2? fv[in2[i]]: sv[in2[i]], d1, d2);
+        const double* dx1=f1? df+in1[i]*w: ds+in1[i]*w;
+        const double* dx2=f2? df+in2[i]*w: ds+in2[i]*w;
+        // only the first argument of single argument operations
+        // contributes. Zero tangents are skipped, as in
+        // EvalOpBase::deriv, so that an infinite partial in an
+        // irrelevant direction does not poison the result
+        bool finiteResult=true;
+        if (!binary(i))
+          for (size_t k=0; k<w; ++k)
+            {
+              r[k] = dx1[k]!=0? dx1[k]*d1: 0;
+              finiteResult &= finite(r[k]);
+            }
+        else
+          for (size_t k=0; k<w; ++k)
+            {
+              r[k] = (dx1[k]!=0? dx1[k]*d1: 0) + (dx2[k]!=0? dx2[k]*d2: 0);
+              finiteResult &= finite(r[k]);
+            }
+        if (!finiteResult) return i;
+      }
+    return -1;
+  }
+
+  void EvalTape::optimise(vector<double>& fv, const vector<bool>& observed)
+  {
+    size_t n=opcode.size(), nFlows=fv.size();
+    assert(observed.size()==nFlows);
+
+    // flow slots not written by the tape, and not visible to the
+    // user, hold values fixed at construction (eg the identity
+    // temporaries of unwired binary operator inputs)
+    vector<bool> known(nFlows, true);
+    for (size_t i=0; i<n; ++i) known[out[i]]=false;
+    for (size_t s=0; s<nFlows; ++s)
+      if (observed[s]) known[s]=false;
+
+    // replacement operands for the outputs of copies
+    vector<int> alias(nFlows, -1);
+    vector<bool> aliasFlow(nFlows, true);
+    vector<bool> keep(n, true);
+    levelStart.clear();
+
+    for (size_t i=0; i<n; ++i)
+      {
+        if (opcode[i]==OperationType::constant ||
+            opcode[i]==OperationType::time)
+          continue;
+
+        // copy propagation
+        if ((flags[i]&flow1Bit) && alias[in1[i]]>=0)
+          {
+            if (!aliasFlow[in1[i]]) flags[i]&=~flow1Bit;
+            in1[i]=alias[in1[i]];
+          }
+        if (binary(i) && (flags[i]&flow2Bit) && alias[in2[i]]>=0)
+          {
+            if (!aliasFlow[in2[i]]) flags[i]&=~flow2Bit;
+            in2[i]=alias[in2[i]];
+          }
+
+        bool k1=(flags[i]&flow1Bit) && known[in1[i]];
+        bool k2=(flags[i]&flow2Bit) && known[in2[i]];
+        if (k1 && (k2 || !binary(i)))
+          {
+            // constant folding. Results of user visible variables are
+            // still computed, but can be folded into later operations
+            double r=applyOp(opcode[i], fv[in1[i]], binary(i)? fv[in2[i]]: 0);
+            if (finite(r))
+              {
+                fv[out[i]]=r;
+                known[out[i]]=true;
+                if (!observed[out[i]]) keep[i]=false;
+              }
+            continue;
+          }
+
+        // x+0, x-0, x*1, x/1, 0+x and 1*x become copies of x
+        if (binary(i))
+          {
+            bool useFirst=false, useSecond=false;
+            switch (opcode[i])
+              {
+              case OperationType::add:
+                useFirst=k2 && fv[in2[i]]==0;
+                useSecond=k1 && fv[in1[i]]==0;
+                break;
+              case OperationType::subtract:
+                useFirst=k2 && fv[in2[i]]==0;
+                break;
+              case OperationType::multiply:
+                useFirst=k2 && fv[in2[i]]==1;
+                useSecond=k1 && fv[in1[i]]==1;
+                break;
+              case OperationType::divide:
+                useFirst=k2 && fv[in2[i]]==1;
+                break;
+              default:
+                break;
+              }
+            if (useSecond && !useFirst)
+              {
+                in1[i]=in2[i];
+                flags[i]=(flags[i]&flow2Bit)? flow1Bit: 0;
+              }
+            if (useFirst || useSecond)
+              {
+                opcode[i]=OperationType::copy;
+                in2[i]=out[i];
+                flags[i]|=flow2Bit;
+              }
+          }
+
+        if (opcode[i]==OperationType::copy)
+          {
+            // later uses read the source directly, so the copy itself
+            // is only needed for user visible variables
+            alias[out[i]]=in1[i];
+            aliasFlow[out[i]]=flags[i]&flow1Bit;
+            if (!observed[out[i]]) keep[i]=false;
+          }
+      }
+
+    // dead code elimination
+    vector<bool> live(observed);
+    for (size_t i=n; i-->0;)
+      {
+        if (!keep[i]) continue;
+        if (!live[out[i]])
+          {
+            keep[i]=false;
+            continue;
+          }
+        if (flags[i]&flow1Bit) live[in1[i]]=true;
+        if (binary(i) && (flags[i]&flow2Bit)) live[in2[i]]=true;
+      }
+
+    size_t j=0;
+    for (size_t i=0; i<n; ++i)
+      if (keep[i])
+        {
+          opcode[j]=opcode[i];
+          out[j]=out[i]; in1[j]=in1[i]; in2[j]=in2[i];
+          flags[j]=flags[i];
+          param[j]=param[i];
+          source[j]=source[i];
+          ++j;
+        }
+    opcode.resize(j);
+    out.resize(j); in1.resize(j); in2.resize(j);
+    flags.resize(j);
+    param.resize(j);
+    source.resize(j);
+  }
+
+  void EvalTape::schedule()
+  {
+    size_t n=size();
+    int nSlots=0;
+    for (size_t i=0; i<n; ++i)
+      nSlots=max(nSlots, max(out[i], max(in1[i], in2[i]))+1);
+
+    // each instruction must come after the last write of its flow
+    // operands, and after any earlier reads or writes of its output
+    vector<int> lastWrite(nSlots, -1), lastRead(nSlots, -1), level(n);
+    int nLevels=0;
+    for (size_t i=0; i<n; ++i)
+      {
+        bool hasArgs=opcode[i]!=OperationType::constant &&
+          opcode[i]!=OperationType::time;
+        bool f1=hasArgs && (flags[i]&flow1Bit);
+        bool f2=hasArgs && binary(i) && (flags[i]&flow2Bit);
+        int l=max(lastWrite[out[i]], lastRead[out[i]])+1;
+        if (f1) l=max(l, lastWrite[in1[i]]+1);
+        if (f2) l=max(l, lastWrite[in2[i]]+1);
+        level[i]=l;
+        lastWrite[out[i]]=l;
+        if (f1) lastRead[in1[i]]=max(lastRead[in1[i]], l);
+        if (f2) lastRead[in2[i]]=max(lastRead[in2[i]], l);
+        nLevels=max(nLevels, l+1);
+      }
+
+    // stable counting sort by level
+    levelStart.assign(nLevels+1, 0);
+    for (size_t i=0; i<n; ++i) levelStart[level[i]+1]++;
+    for (int l=0; l<nLevels; ++l) levelStart[l+1]+=levelStart[l];
+    vector<int> pos(levelStart.begin(), levelStart.end()-1), perm(n);
+    for (size_t i=0; i<n; ++i) perm[pos[level[i]]++]=i;
+
+    EvalTape sorted;
+    for (size_t j=0; j<n; ++j)
+      {
+        int i=perm[j];
+        sorted.opcode.push_back(opcode[i]);
+        sorted.out.push_back(out[i]);
+        sorted.in1.push_back(in1[i]);
+        sorted.in2.push_back(in2[i]);
+        sorted.flags.push_back(flags[i]);
+        sorted.param.push_back(param[i]);
+        sorted.source.push_back(source[i]);
+      }
+    opcode.swap(sorted.opcode);
+    out.swap(sorted.out); in1.swap(sorted.in1); in2.swap(sorted.in2);
+    flags.swap(sorted.flags);
+    param.swap(sorted.param);
+    source.swap(sorted.source);
+  }
+
+  namespace
+  {
+    /// evaluates a range of instructions within a level
+    struct EvalLevel: public ThreadPool::Task
+    {
+      const EvalTape& tape;
+      double* fv;
+      const double* sv;
+      double t;
+      size_t offset;
+      int bad; ///< first invalid instruction, or -1
+      EvalLevel(const EvalTape& tape, double fv[], const double sv[], double t):
+        tape(tape), fv(fv), sv(sv), t(t), offset(0), bad(-1) {}
+      void operator()(size_t begin, size_t end)
+      {
+        int r=tape.evalRange(fv, sv, t, offset+begin, offset+end);
+        if (r>=0)
+          for (int b=bad; (b<0 || r<b) && 
+                 !__sync_bool_compare_and_swap(&bad, b, r); b=bad);
+      }
+    };
+  }
+
+  int EvalTape::eval(double fv[], const double sv[], double t, 
+                     ThreadPool& pool, size_t threshold) const
+  {
+    if (levelStart.empty()) return eval(fv, sv, t);
+    EvalLevel task(*this, fv, sv, t);
+    size_t split=4*pool.size();
+    for (size_t l=0; l+1<levelStart.size(); ++l)
+      {
+        size_t begin=levelStart[l], n=levelStart[l+1]-begin;
+        if (n<threshold)
+          {
+            int r=evalRange(fv, sv, t, begin, begin+n);
+            if (r>=0) return r;
+          }
+        else
+          {
+            task.offset=begin;
+            pool.parallelFor(n, (n+split-1)/split, task);
+            if (task.bad>=0) return task.bad;
+          }
+      }
+    return -1;
+  }
+}
@@ -0,0 +1,120 @@
+/*
+  @copyright Steve Keen 2013
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef EVALTAPE_H
+#define EVALTAPE_H
+
+#include "evalOp.h"
+#include "threadPool.h"
+#include <vector>
+
+namespace minsky
+{
+  using namespace std;
+
+  /**
+     The equation list lowered into a flat instruction tape. Each
+     EvalOp becomes a row of the following parallel arrays, which are
+     executed in order by a single switch interpreter, avoiding a
+     virtual call and pointer chase per operation.
+  */
+  struct EvalTape
+  {
+    /// bits of flags, indicating whether in1/in2 refer to flow variables
+    enum {flow1Bit=1, flow2Bit=2};
+    /// number of tangent directions propagated together by deriv()
+    enum {derivWidth=4};
+
+    vector<unsigned char> opcode; ///< OperationType::Type of each op
+    vector<int> out, in1, in2;    ///< indexes into the value vectors
+    vector<unsigned char> flags;  ///< operand source bits
+    /// index into constants for constant ops, -1 otherwise
+    vector<int> param;
+    /// Constant operations referred to by param. Values are read on
+    /// each evaluation, so that sliders take effect immediately
+    vector<OperationPtr> constants;
+    /// index of the EvalOp in the original equation list that each
+    /// instruction was lowered from (for diagnostics)
+    vector<int> source;
+    /// start of each level of mutually independent instructions, with
+    /// a final entry of size(). Set by schedule()
+    vector<int> levelStart;
+
+    size_t size() const {return opcode.size();}
+    /// whether instruction \a i uses its second operand
+    bool binary(size_t i) const
+    {return !((flags[i]&flow2Bit) && in2[i]==out[i]);}
+    bool empty() const {return opcode.empty();}
+    void clear();
+
+    /// lower \a equations into this tape
+    /// @throws ecolab::error if an operation cannot be evaluated
+    void compile(const vector<EvalOpPtr>& equations);
+
+    /// evaluate the tape over flow variables \a fv and stock
+    /// variables \a sv, at time \a t.
+    /// @return -1 on success, or the position of the first
+    /// instruction producing a non-finite result, at which point
+    /// evaluation stops
+    int eval(double fv[], const double sv[], double t) const
+    {return evalRange(fv, sv, t, 0, size());}
+    /// evaluate instructions [\a begin, \a end) of the tape, as eval()
+    int evalRange(double fv[], const double sv[], double t, 
+                  size_t begin, size_t end) const;
+    /// as eval(), but evaluating levels of at least \a threshold
+    /// instructions in parallel on \a pool
+    int eval(double fv[], const double sv[], double t, 
+             ThreadPool& pool, size_t threshold) const;
+
+    /// evaluate the tape over \a nLanes variants of the model at once.
+    /// Each slot of \a fv and \a sv holds \a nLanes consecutive
+    /// values, ie lane k of flow variable i is fv[i*nLanes+k]. \a
+    /// params, if given, likewise holds the value of each Constant of
+    /// constants in each lane, otherwise the current Constant values
+    /// are used in all lanes.
+    /// @return as eval(), if any lane produces a non-finite result
+    int evalLanes(double fv[], const double sv[], double t, size_t nLanes,
+                  const double params[]=NULL) const;
+
+    /// reorder the instructions by level, such that instructions
+    /// within a level do not depend on each other
+    void schedule();
+
+    /// forward mode derivative of the tape along derivWidth directions
+    /// at once. \a ds and \a df hold derivWidth consecutive entries
+    /// per stock and flow variable respectively, ie the tangent of
+    /// direction k of flow variable i is df[i*derivWidth+k]. \a sv and
+    /// \a fv are the point of evaluation, as returned by eval().
+    /// \a dt, if given, is the tangent of time in each direction.
+    /// @return -1 on success, or the position of the first
+    /// instruction producing a non-finite derivative
+    int deriv(double df[], const double ds[], const double sv[],
+              const double fv[], const double dt[]=NULL) const;
+
+    /// Simplify the tape by copy propagation, constant folding and
+    /// dead code elimination. \a observed flags the flow variables
+    /// whose values must be maintained, such as named variables and
+    /// integral inputs. \a fv holds the initial flow variables, and
+    /// receives the values of folded constants, so must be used to
+    /// initialise the flow variables passed to eval().
+    void optimise(vector<double>& fv, const vector<bool>& observed);
+  };
+}
+
+#include "evalTape.cd"
+#endif
@@ -121,15 +121,17 @@ vector<string> GodleyTable::getVariables() const
 {
   vector<string> vars; 
   set<string> uvars; //set for uniqueness checking
+  double coef;
+  string var;
   for (size_t r=1; r<rows(); ++r)
     if (!initialConditionRow(r))
       for (size_t c=1; c<cols(); ++c)
-        {
-          string var=cell(r,c);
-          stripNonAlnum(var);
-          if (!var.empty() && uvars.insert(var).second)
-            vars.push_back(var);
-        }
+        if (parseGodleyCell(cell(r,c), coef, var))
+          {
+            stripNonAlnum(var);
+            if (!var.empty() && uvars.insert(var).second)
+              vars.push_back(var);
+          }
   return vars;
 }
 
@@ -161,48 +163,60 @@ string GodleyTable::assetClass(TCL_args args)
   return classdesc::enumKey<AssetClass>(_assetClass(col));
 }
 
-string GodleyTable::RowSum(int row) const
+bool minsky::parseGodleyCell(const string& formula, double& coef, string& varName)
 {
-  // accumulate the total for each variable
-  map<string,double> sum;
-  for (int c=1; c<cols(); ++c)
+  const char* f=formula.c_str();
+  char* tail=const_cast<char*>(f);
+  // attempt to read leading numerical value. Only digits are
+  // considered, so that names like "inflow" are not read as infinity
+  const char* g=f;
+  while (*g != '\0' && isspace(*g)) ++g;
+  if (*g=='+' || *g=='-') ++g;
+  if (isdigit(*g) || *g=='.')
+    coef=strtod(f,&tail);
+  if (tail==f) // oops, that failed, check if there's a leading - sign
     {
-      const string& formula = cell(row,c);
-      const char* f=formula.c_str();
-      char* tail;
-      // attempt to read leading numerical value
-      double coef=strtod(f,&tail);
-      if (tail==f) // oops, that failed, check if there's a leading - sign
+      // skip whitespace
+      while (*tail != '\0' && isspace(*tail)) ++tail;
+      if (*tail=='\0') return false; // empty cell, nothing to do
+      if (*tail=='-') 
         {
-          // skip whitespace
-          while (*tail != '\0' && isspace(*tail)) ++tail;
-          if (*tail=='\0') continue; // empty cell, nothing to do
-          if (*tail=='-') 
-            {
-              coef=-1; // treat leading - sign as -1
-              tail++;
-            }
-          else
-            coef=1;
+          coef=-1; // treat leading - sign as -1
+          tail++;
         }
+      else
+        coef=1;
+    }
 
-      // whatever's left is the name of the variable. Add characters,
-      // but avoid adding trailing whitspace
-      string varName;
-      int numWhite=0;
-      for (;*tail!='\0'; ++tail) 
+  // whatever's left is the name of the variable. Add characters,
+  // but avoid adding trailing whitspace
+  varName.clear();
+  int numWhite=0;
+  for (;*tail!='\0'; ++tail) 
+    {
+      if (isspace(*tail))
+        numWhite++;
+      else if (numWhite)
         {
-          if (isspace(*tail))
-            numWhite++;
-          else if (numWhite)
-            {
-              varName.append(' ',numWhite);
-              numWhite=0;
-            }
-          varName+=*tail;
+          if (!varName.empty()) varName.append(numWhite,' ');
+          numWhite=0;
         }
+      if (!isspace(*tail))
+        varName+=*tail;
+    }
+  return true;
+}
 
-      sum[varName]+=coef;
+string GodleyTable::RowSum(int row) const
+{
+  // accumulate the total for each variable
+  map<string,double> sum;
+  for (int c=1; c<cols(); ++c)
+    {
+      double coef;
+      string varName;
+      if (parseGodleyCell(cell(row,c), coef, varName))
+        sum[varName]+=coef;
     }
 
   // create symbolic representation of each term
@@ -157,6 +157,13 @@ namespace minsky
   inline void stripNonAlnum(string& x) {
     x.erase(remove_if(x.begin(), x.end(), IsNotalnum), x.end());
   } 
+
+  /// split a Godley table cell \a formula into a leading numerical
+  /// coefficient and the variable name that follows it, with trailing
+  /// whitespace removed. A missing coefficient is taken to be 1, or -1
+  /// if the name is preceded by a - sign.
+  /// @return false if the cell is empty
+  bool parseGodleyCell(const string& formula, double& coef, string& varName);
 }
 
 #include "godley.cd"
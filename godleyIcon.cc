@@ -244,6 +244,7 @@ inline bool isDotOrDigit(char x)
 
 void GodleyIcon::update()
 {
+  minsky().canvasJournal.touched(this);
   updateVars(stockVars, table.getColumnVariables(), VariableType::stock);
   updateVars(flowVars, table.getVariables(), VariableType::flow);
 
@@ -340,6 +341,7 @@ void GodleyIcon::MoveTo(float x1, float y1)
 {
   float dx=x1-x(), dy=y1-y();
   m_x=x1; m_y=y1;
+  minsky().canvasJournal.touched(this);
   //const_cast OK below because location doesn't affect ordering
    for (Variables::iterator v=flowVars.begin(); v!=flowVars.end(); ++v)
      const_cast<VariableBase&>(**v).move(dx, dy); 
@@ -359,7 +361,7 @@ int GodleyIcon::Select(float x, float y)
   return -1;
 }
 
-void GodleyIcon::zoom(float xOrigin, float yOrigin,float factor) {
+void GodleyIcon::zoom(float xOrigin, float yOrigin,double factor) {
   minsky::zoom(m_x, xOrigin, factor);
   minsky::zoom(m_y, yOrigin, factor);
   zoomFactor*=factor;
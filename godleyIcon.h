@@ -74,8 +74,8 @@ namespace minsky
 
     /// zoom by \a factor, scaling all widget's coordinates, using (\a
     /// xOrigin, \a yOrigin) as the origin of the zoom transformation
-    void zoom(float xOrigin, float yOrigin,float factor);
-    float zoomFactor;
+    void zoom(float xOrigin, float yOrigin,double factor);
+    double zoomFactor;
 
 
   };
@@ -0,0 +1,96 @@
+/*
+  @copyright Steve Keen 2013
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "godleyIncidence.h"
+#include <ecolab_epilogue.h>
+
+namespace minsky
+{
+  void GodleyIncidence::compile(const map<int, GodleyIcon>& godleyItems,
+                                const VariableManager& variables,
+                                size_t nStocks)
+  {
+    clear();
+    // coefficients of each flow, by stock
+    vector<map<int,double> > rows(nStocks);
+    string name;
+    double c;
+    for (map<int, GodleyIcon>::const_iterator gi=godleyItems.begin(); 
+         gi!=godleyItems.end(); ++gi)
+      {
+        const GodleyTable& godley=gi->second.table;
+        for (size_t col=1; col<godley.cols(); ++col)
+          {
+            name=godley.cell(0,col);
+            stripNonAlnum(name);
+            int stock=variables.getVariableValue(name).idx();
+            if (stock<0) continue; //variable undefined
+            assert(size_t(stock)<nStocks);
+            double sign=godley.signConventionReversed(col)? -1: 1;
+
+            for (size_t r=1; r<godley.rows(); ++r)
+              {
+                if (godley.initialConditionRow(r)) continue;
+                if (!parseGodleyCell(godley.cell(r,col), c, name)) continue;
+                stripNonAlnum(name);
+                int f=variables.getVariableValue(name).idx();
+                if (f<0) continue;
+                rows[stock][f]+=sign*c;
+              }
+          }
+      }
+
+    rowStart.push_back(0);
+    for (size_t s=0; s<nStocks; ++s)
+      {
+        for (map<int,double>::const_iterator i=rows[s].begin(); 
+             i!=rows[s].end(); ++i)
+          {
+            flow.push_back(i->first);
+            coef.push_back(i->second);
+          }
+        rowStart.push_back(flow.size());
+      }
+  }
+
+  void GodleyIncidence::apply(double sv[], const double fv[]) const
+  {
+    for (size_t s=0; s+1<rowStart.size(); ++s)
+      {
+        double sum=0;
+        for (int p=rowStart[s]; p<rowStart[s+1]; ++p)
+          sum+=coef[p]*fv[flow[p]];
+        sv[s]+=sum;
+      }
+  }
+
+  void GodleyIncidence::applyLanes(double sv[], const double fv[], 
+                                   size_t nLanes) const
+  {
+    for (size_t s=0; s+1<rowStart.size(); ++s)
+      {
+        double* r=sv+s*nLanes;
+        for (int p=rowStart[s]; p<rowStart[s+1]; ++p)
+          {
+            const double* f=fv+flow[p]*nLanes;
+            double c=coef[p];
+            for (size_t k=0; k<nLanes; ++k) r[k]+=c*f[k];
+          }
+      }
+  }
+}
@@ -0,0 +1,64 @@
+/*
+  @copyright Steve Keen 2013
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef GODLEYINCIDENCE_H
+#define GODLEYINCIDENCE_H
+
+#include "godleyIcon.h"
+#include "variableManager.h"
+#include <vector>
+#include <map>
+
+namespace minsky
+{
+  using namespace std;
+
+  /**
+     All Godley tables compiled into a signed sparse matrix in CSR
+     form, mapping flow variables to the derivatives of the stock
+     variables heading the columns they appear in. Cell names are
+     resolved once, so evaluation does no string handling.
+  */
+  struct GodleyIncidence
+  {
+    /// start of each stock variable's entries in flow and coef, with
+    /// rowStart[nStocks]=nonZeros()
+    vector<int> rowStart;
+    vector<int> flow;    ///< flow variable index of each entry
+    vector<double> coef; ///< coefficient of each entry
+
+    size_t nonZeros() const {return flow.size();}
+    void clear() {rowStart.clear(); flow.clear(); coef.clear();}
+
+    /// compile \a godleyItems for \a nStocks stock variables, looking
+    /// up variable indices in \a variables. Coefficients account for
+    /// the sign convention of each column, and any numerical prefix
+    /// of a cell. Repeated flows in a column are combined.
+    void compile(const map<int, GodleyIcon>& godleyItems,
+                 const VariableManager& variables, size_t nStocks);
+
+    /// add the contribution of flows \a fv to stock derivatives \a sv
+    void apply(double sv[], const double fv[]) const;
+    /// as apply(), for \a nLanes interleaved variants of the model,
+    /// laid out as for EvalTape::evalLanes
+    void applyLanes(double sv[], const double fv[], size_t nLanes) const;
+  };
+}
+
+#include "godleyIncidence.cd"
+#endif
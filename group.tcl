@@ -66,12 +66,12 @@ proc rightMouseGroup {id x y X Y} {
 
 proc deleteGroupItem {id} {
     deleteGroup $id
-    updateCanvas
+    refreshCanvas
 }
 
 proc ungroupGroupItem {id} {
     ungroup $id
-    updateCanvas
+    refreshCanvas
 }
 
 proc lasso {x y} {
@@ -92,7 +92,7 @@ proc lassoEnd {x y} {
         set y [.wiring.canvas canvasy $y]
         eval group $x $y $lassoStart
         .wiring.canvas delete lasso
-        updateCanvas
+        refreshCanvas
         unset lassoStart
         # convert back to move mode for later editing
         global interactionMode
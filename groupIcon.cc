@@ -58,11 +58,16 @@ namespace
       abs(x)>=epsilon && abs((x-y)/x)<epsilon;
   }
 
-  // return true if \a rect overlaps partly, or wholly \a poly
-  bool includesPart(const Rectangle& rect, const Polygon& poly)
+  /// ids of the items of kind \a kind in \a items, in ascending order
+  vector<int> idsOf(const SceneIndex::Items& items, 
+                    SceneIndex::Item::Kind kind)
   {
-    return covered_by(return_envelope<Rectangle>(poly), rect) || 
-      intersects(rect, poly);
+    vector<int> r;
+    for (SceneIndex::Items::const_iterator i=items.begin(); 
+         i!=items.end(); ++i)
+      if (i->kind==kind)
+        r.push_back(i->id);
+    return r;
   }
 
   /// translate a wire coordinate list by (\a dx,\a dy)
@@ -258,6 +263,7 @@ namespace
            {
              Wire& w=minsky::minsky().wires[*i];
              w.visible=true;
+             minsky::minsky().canvasJournal.touched(&w);
              cmd << "adjustWire"<<w.to<<"\n";
              cmd|".wiring.canvas addtag groupitems"|id|" withtag wire"|*i|"\n";
            }
@@ -273,6 +279,7 @@ namespace
               op.m_y/=op.zoomFactor;
               op.zoomFactor=1;
               op.visible=false;
+              minsky::minsky().touched(&op);
             }
           set<int> eVars=g.edgeSet();
           for (i=g.variables().begin(); i!=g.variables().end(); ++i)
@@ -283,10 +290,13 @@ namespace
                 v.m_y/=v.zoomFactor;
                 v.zoomFactor=1;
                 v.visible=false;              
+                minsky::minsky().touched(&v);
               }
           for (i=g.wires().begin(); i!=g.wires().end(); ++i)
             {
-              minsky::minsky().wires[*i].visible=false;
+              Wire& w=minsky::minsky().wires[*i];
+              w.visible=false;
+              minsky::minsky().canvasJournal.touched(&w);
             }
          for (i=g.groups().begin(); i!=g.groups().end(); ++i)
            {
@@ -350,8 +360,6 @@ namespace
 #ifdef __GNUC__
 #pragma GCC pop
 #endif
-
-  Minsky* l_minsky=NULL;
 }
 
 static int dum=(initVec().push_back(registerItem), 0);
@@ -365,12 +373,13 @@ void GroupIcon::deleteContents()
   for (vector<int>::const_iterator i=m_operations.begin(); 
        i!=m_operations.end(); ++i)
     minsky().operations.erase(*i);
+  minsky().variables.integralsChanged();
   for (vector<int>::const_iterator i=m_variables.begin(); 
        i!=m_variables.end(); ++i)
     minsky().variables.erase(*i);
   for (vector<int>::const_iterator i=m_wires.begin(); 
        i!=m_wires.end(); ++i)
-    minsky().wires.erase(*i);
+    portManager().deleteWire(*i);
 }
 
 
@@ -471,7 +480,7 @@ void GroupIcon::addEdgeVariable
   newV->visible=false;
   Port& p=portManager().ports[port];
   // insert variable into wire
-  array<int> wires=portManager().WiresAttachedToPort(port);
+  PortManager::WireIds wires=portManager().WiresAttachedToPort(port);
   for (int w=0; w<wires.size(); ++w)
     {
       Wire& wire=portManager().wires[wires[w]];
@@ -480,6 +489,7 @@ void GroupIcon::addEdgeVariable
       else
         portManager().wires[wires[w]].from=newV->outPort();
     }
+  portManager().wiresChanged();
   if (p.input)
     additionalWires.push_back(Wire(newV->outPort(),port));
   else
@@ -539,12 +549,14 @@ void GroupIcon::createGroup(float x0, float y0, float x1, float y1)
   // internal to this grouping. TODO - extend this logic to variables
   // and operators.
   set<int> externalGroupPorts;
+  vector<int> lassoedGroups=idsOf
+    (minsky().sceneIndex.Intersecting(minsky(), bbox), SceneIndex::Item::group);
   for (GroupIcons::iterator g=minsky().groupItems.begin(); 
        g!=minsky().groupItems.end(); ++g)
     {
       GroupIcon& gi=g->second;
       if (gi.id!=id && gi.parent()==parent() && 
-          includesPart(bbox, gi.geom()))
+          binary_search(lassoedGroups.begin(), lassoedGroups.end(), gi.id))
         {
           addGroup(*g);
           gi.visible=false;
@@ -598,60 +610,73 @@ void GroupIcon::createGroup(float x0, float y0, float x1, float y1)
   // track variables already added
   set<int> varsAlreadyAdded(m_variables.begin(), m_variables.end());
   VariableManager& vars=minsky().variables;
-  for (VariableManager::iterator v=vars.begin(); 
-       v!=vars.end(); ++v)
-    if (v->second->group==parent() && varsAlreadyAdded.count(v->first)==0 && 
-        includesPart(bbox, RenderVariable(v->second).geom()))
-      {
-        if (parentGroup) parentGroup->removeVariable(*v);
-        addVariable(*v);
-        v->second->visible=false;
-        // if any of the wires from this variable terminate outside,
-        // then push onto the I/O list
-        array<int> inWires=minsky().WiresAttachedToPort(v->second->inPort());
-        for (array<int>::iterator w=inWires.begin(); w!=inWires.end(); ++w)
-          if (minsky().wires[*w].group!=id)
-            {
-              if (inVarNames.insert(v->second->Name()).second)
-                inVariables.insert(v->first);
-              break;
-            }
-        array<int> outWires=minsky().WiresAttachedToPort(v->second->outPort());
-        for (array<int>::iterator w=outWires.begin(); w!=outWires.end(); ++w)
-          if (minsky().wires[*w].group!=id)
-            {
-              if (outVarNames.insert(v->second->Name()).second)
-                outVariables.insert(v->first);
-              break;
-            }
-      }
+  // variables and operations within the lasso
+  const SceneIndex::Items lassoed=
+    minsky().sceneIndex.Intersecting(minsky(), bbox);
+  vector<int> lassoedVars=idsOf(lassoed, SceneIndex::Item::variable);
+  for (vector<int>::const_iterator i=lassoedVars.begin(); 
+       i!=lassoedVars.end(); ++i)
+    {
+      VariableManager::iterator v=vars.find(*i);
+      if (v->second->group==parent() && varsAlreadyAdded.count(v->first)==0)
+        {
+          if (parentGroup) parentGroup->removeVariable(*v);
+          addVariable(*v);
+          v->second->visible=false;
+          // if any of the wires from this variable terminate outside,
+          // then push onto the I/O list
+          const PortManager::WireIds& inWires=
+            minsky().WiresAttachedToPort(v->second->inPort());
+          for (PortManager::WireIds::const_iterator w=inWires.begin(); 
+               w!=inWires.end(); ++w)
+            if (minsky().wires[*w].group!=id)
+              {
+                if (inVarNames.insert(v->second->Name()).second)
+                  inVariables.insert(v->first);
+                break;
+              }
+          const PortManager::WireIds& outWires=
+            minsky().WiresAttachedToPort(v->second->outPort());
+          for (PortManager::WireIds::const_iterator w=outWires.begin(); 
+               w!=outWires.end(); ++w)
+            if (minsky().wires[*w].group!=id)
+              {
+                if (outVarNames.insert(v->second->Name()).second)
+                  outVariables.insert(v->first);
+                break;
+              }
+        }
+    }
 
-  for (Operations::iterator o=minsky().operations.begin(); 
-       o!=minsky().operations.end(); ++o)
-    if (o->second->group==parent() && 
-        intersects(bbox, RenderOperation(o->second).geom()))
-      {
-        if (parentGroup) parentGroup->removeOperation(*o);
-        addOperation(*o);
-        o->second->visible=false;
-        // If an integral variable is output variable, unbind the
-        // integral operator for neatness
-        if (IntOp* integ=dynamic_cast<IntOp*>(o->second.get()))
-          if (outVarNames.count(integ->description()) && integ->coupled())
-            {
-              integ->toggleCoupled();
-              // add created wire to group
-              assert(minsky::minsky().WiresAttachedToPort(integ->ports()[0]).size()==1);
-              m_wires.push_back
-                (minsky::minsky().WiresAttachedToPort(integ->ports()[0])[0]);
-              Wire& w=minsky::minsky().wires[m_wires.back()];
-              w.visible=false;
-              array<float> coords=w.Coords();
-              w.group=id;
-              // translate coordinates to be relative
-              w.Coords(coords);
-            }
-      }
+  vector<int> lassoedOps=idsOf(lassoed, SceneIndex::Item::operation);
+  for (vector<int>::const_iterator i=lassoedOps.begin(); 
+       i!=lassoedOps.end(); ++i)
+    {
+      Operations::iterator o=minsky().operations.find(*i);
+      if (o->second->group==parent())
+        {
+          if (parentGroup) parentGroup->removeOperation(*o);
+          addOperation(*o);
+          o->second->visible=false;
+          // If an integral variable is output variable, unbind the
+          // integral operator for neatness
+          if (IntOp* integ=dynamic_cast<IntOp*>(o->second.get()))
+            if (outVarNames.count(integ->description()) && integ->coupled())
+              {
+                integ->toggleCoupled();
+                // add created wire to group
+                assert(minsky::minsky().WiresAttachedToPort(integ->ports()[0]).size()==1);
+                m_wires.push_back
+                  (minsky::minsky().WiresAttachedToPort(integ->ports()[0])[0]);
+                Wire& w=minsky::minsky().wires[m_wires.back()];
+                w.visible=false;
+                array<float> coords=w.Coords();
+                w.group=id;
+                // translate coordinates to be relative
+                w.Coords(coords);
+              }
+        }
+    }
 
   // now add the additional wires to port manager
   for (size_t i=0; i<additionalWires.size(); ++i)
@@ -660,6 +685,7 @@ void GroupIcon::createGroup(float x0, float y0, float x1, float y1)
   // make width & height slightly smaller than contentBounds
   contentBounds(x0,y0,x1,y1);
   width=0.95*abs(x1-x0); height=0.95*abs(y1-y0);
+  minsky().touched(SceneIndex::Item(SceneIndex::Item::group, id));
   computeDisplayZoom();
   updatePortLocation();
 
@@ -786,11 +812,13 @@ void GroupIcon::ungroup()
     {
       // before deleting the variables, we need to join the wires
       VariablePtr v=minsky().variables[*i];
-      array<int> incomingWires=minsky().WiresAttachedToPort(v->inPort());
+      PortManager::WireIds incomingWires=
+        minsky().WiresAttachedToPort(v->inPort());
       assert(incomingWires.size()<=1);
       if (incomingWires.size()>0)
         {
-          array<int> outgoingWires=minsky().WiresAttachedToPort(v->outPort());
+          PortManager::WireIds outgoingWires=
+            minsky().WiresAttachedToPort(v->outPort());
           Wire& inWire=minsky().wires[incomingWires[0]];
           for (size_t j=0; j<outgoingWires.size(); ++j)
             {
@@ -803,6 +831,7 @@ void GroupIcon::ungroup()
               w.group=inWire.group;
               assert(w.Coords().size()>=4);
             }
+          minsky().wiresChanged();
         }
       minsky().variables.erase(*i);
     }
@@ -815,6 +844,8 @@ void GroupIcon::MoveTo(float x1, float y1)
 {
   float dx=x1-x(), dy=y1-y();
   m_x+=dx; m_y+=dy;
+  // also re-examines the contents, which are placed relative to the group
+  minsky().touched(this);
   
   /*
     TODO, callbacks to TCL interpreter is way to slow - figure out how
@@ -1087,7 +1118,7 @@ void GroupIcon::margins(float& left, float& right) const
     }
 }
 
-void GroupIcon::zoom(float xOrigin, float yOrigin,float factor) {
+void GroupIcon::zoom(float xOrigin, float yOrigin,double factor) {
   if (visible)
     {
       if (m_parent==-1)
@@ -1101,11 +1132,12 @@ void GroupIcon::zoom(float xOrigin, float yOrigin,float factor) {
           m_y*=factor;
         }
       zoomFactor*=factor;
+      minsky().touched(this);
       updatePortLocation(); // should force edge wire coordinates to update
     }
 }
 
-float GroupIcon::computeDisplayZoom()
+double GroupIcon::computeDisplayZoom()
 {
   float x0, x1, y0, y1, l, r;
   contentBounds(x0,y0,x1,y1);
@@ -1128,7 +1160,11 @@ void GroupIcon::addAnyWires(const S& ports)
 {
   array<int> wiresToCheck;
   for (size_t i=0; i<ports.size(); ++i)
-    wiresToCheck <<= portManager().WiresAttachedToPort(ports[i]);
+    {
+      const PortManager::WireIds& w=portManager().WiresAttachedToPort(ports[i]);
+      for (size_t j=0; j<w.size(); ++j)
+        wiresToCheck <<= w[j];
+    }
   if (wiresToCheck.size()>0)
     {
       // first build list of contained ports
@@ -1325,10 +1361,11 @@ void GroupIcon::removeGroup(std::pair<const int,GroupIcon>& pg)
     }
 }
 
-void GroupIcon::setZoom(float factor)
+void GroupIcon::setZoom(double factor)
 {
   zoomFactor=factor;
-  float lzoom=localZoom();
+  minsky().touched(this);
+  double lzoom=localZoom();
   vector<int>::iterator i;
   for (i=m_operations.begin(); i!=m_operations.end(); ++i)
     minsky::minsky().operations[*i]->setZoom(lzoom);
@@ -1361,6 +1398,7 @@ namespace
 void GroupIcon::Rotate(float angle)
 {
   rotation+=angle;
+  minsky().touched(this);
   //  float ca=cos(M_PI*angle/180), sa=(M_PI*angle/180);
   ::Rotate rotate(angle, x(), y());
 
@@ -53,7 +53,7 @@ namespace minsky
     /// is included
     std::set<std::string> inVarNames, outVarNames;
     float m_x, m_y; ///< icon position
-    float m_localZoom;
+    double m_localZoom;
     int id, m_parent;
 
     friend struct SchemaHelper;
@@ -166,21 +166,21 @@ namespace minsky
 
     /// zoom by \a factor, scaling all widget's coordinates, using (\a
     /// xOrigin, \a yOrigin) as the origin of the zoom transformation
-    void zoom(float xOrigin, float yOrigin,float factor);
-    float zoomFactor;
+    void zoom(float xOrigin, float yOrigin,double factor);
+    double zoomFactor;
     /// sets the zoomFactor, and the appropriate zoom factors for all
     /// contained items
-    void setZoom(float factor);
+    void setZoom(double factor);
 
     /// delete contents, leaving an empty group
     void deleteContents();
 
     /// computes the zoom at which to show contents, given current
     /// contentBounds and width
-    float displayZoom; ///< zoom at which contents are displayed
-    float computeDisplayZoom();
-    //    float localZoom() const {return m_localZoom;}
-    float localZoom() const {
+    double displayZoom; ///< zoom at which contents are displayed
+    double computeDisplayZoom();
+    //    double localZoom() const {return m_localZoom;}
+    double localZoom() const {
       return (displayZoom>0 && zoomFactor>displayZoom)
         ? zoomFactor/displayZoom: 1;
     }
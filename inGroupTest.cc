@@ -18,6 +18,10 @@
 */
 
 #include "inGroupTest.h"
+#include "geometry.h"
+#include <boost/geometry/geometry.hpp>
+#include <boost/geometry/index/rtree.hpp>
+#include <limits>
 
 using namespace minsky;
 using namespace std;
@@ -35,6 +39,40 @@ InGroup::Cell::Cell(int id, const GroupIcon& g):
 }
 
 
+namespace minsky
+{
+  namespace bgi=boost::geometry::index;
+
+  /// R-tree of group extents. The Cells last indexed are kept
+  /// alongside, so that changed groups can be found and replaced in
+  /// the tree without rebuilding it.
+  struct GroupIndex
+  {
+    typedef pair<Rectangle,int> Entry;
+    typedef bgi::rtree<Entry, bgi::quadratic<16> > Tree;
+    typedef map<int, InGroup::Cell> Cells;
+    Tree tree;
+    Cells cells;
+
+    static Entry entry(const InGroup::Cell& c)
+    {return Entry(Rectangle(Point(c.x0,c.y0), Point(c.x1,c.y1)), c.id);}
+
+    void insert(Cells::iterator hint, const InGroup::Cell& c) {
+      cells.insert(hint, Cells::value_type(c.id, c));
+      tree.insert(entry(c));
+    }
+    void update(Cells::iterator i, const InGroup::Cell& c) {
+      tree.remove(entry(i->second));
+      i->second=c;
+      tree.insert(entry(c));
+    }
+    void erase(Cells::iterator i) {
+      tree.remove(entry(i->second));
+      cells.erase(i);
+    }
+  };
+}
+
 namespace
 {
   void excludeSelfAndChildren(set<int>& excludeIds, 
@@ -53,58 +91,63 @@ namespace
      
 }
 
+void InGroup::copyIndex(const InGroup& x)
+{
+  if (x.index)
+    index.reset(new GroupIndex(*x.index));
+  else
+    index.reset();
+}
+
 void InGroup::initGroupList(const map<int, GroupIcon>& g, int exclude)
 {
-  cells.clear();
-  // construct all the Cells
-  vector<Cell> rects;
-  set<int> excludeIds;
-  excludeSelfAndChildren(excludeIds, g, exclude);
-
-  for (std::map<int, GroupIcon>::const_iterator i=g.begin(); i!=g.end(); ++i)
-    if (excludeIds.count(i->first)==0)
-      rects.push_back(Cell(i->first, i->second));
-
-  // compute total bounds
-  ymin=xmin=numeric_limits<float>::max(); ymax=xmax=-xmin;
-  for (vector<Cell>::const_iterator i=rects.begin(); i!=rects.end(); ++i)
+  if (!index) index.reset(new GroupIndex);
+  GroupIndex::Cells& cells=index->cells;
+
+  // both maps are ordered by id, so walk them together, dropping
+  // deleted groups, and adding or updating those that differ from
+  // what was last indexed
+  GroupIndex::Cells::iterator c=cells.begin();
+  for (map<int, GroupIcon>::const_iterator i=g.begin(); i!=g.end(); ++i)
     {
-      if (xmin>i->x0) xmin=i->x0;
-      if (xmax<i->x1) xmax=i->x1;
-      if (ymin>i->y0) ymin=i->y0;
-      if (ymax<i->y1) ymax=i->y1;
+      while (c!=cells.end() && c->first<i->first)
+        index->erase(c++);
+      Cell cell(i->first, i->second);
+      if (c!=cells.end() && c->first==i->first)
+        {
+          if (!c->second.sameBounds(cell))
+            index->update(c, cell);
+          ++c;
+        }
+      else
+        index->insert(c, cell);
     }
-  if (g.empty()) return;
-
-  // start by assuming rectangles are even distributed, so divide
-  // total area into g.size() cells. If all the rectangles are stacked
-  // on top of each other, this algorithm will be unbalanced, but that
-  // is fairly pathological, as well designed layouts will spread out
-  // the groups
-  float sqrtNoGroups=sqrt(g.size());
-  xBinSz=(xmax-xmin)/sqrtNoGroups;
-  yBinSz=(ymax-ymin)/sqrtNoGroups;
-  cells.resize(int(sqrtNoGroups+1), 
-               std::vector<std::set<Cell> >(int(sqrtNoGroups+1)));
-  for (vector<Cell>::const_iterator i=rects.begin(); i!=rects.end(); ++i)
-    for (float x=i->x0; x<(int((i->x1-xmin)/xBinSz)+1)*xBinSz+xmin; x+=xBinSz)
-      for (float y=i->y0; y<(int((i->y1-ymin)/yBinSz)+1)*yBinSz+ymin; y+=yBinSz)
-        cells[int((x-xmin)/xBinSz)][int((y-ymin)/yBinSz)].insert(*i);
-}
-
-
+  while (c!=cells.end())
+    index->erase(c++);
 
+  excluded.clear();
+  excludeSelfAndChildren(excluded, g, exclude);
+}
 
 int InGroup::ContainingGroup(float x, float y) const
 {
-  if (x<xmin||x>xmax||y<ymin||y>ymax) return -1;
-
-  /// rectangles are binned into cells of size (xBinSz, yBinSz),
-  /// lookup searches linearly over cell contents, sorted by rectangle
-  /// size
-  int xi=(x-xmin)/xBinSz, yi=(y-ymin)/yBinSz;
-  for (set<Cell>::const_iterator i=cells[xi][yi].begin(); i!=cells[xi][yi].end(); ++i)
-    if (i->inRect(x,y))
-      return i->id;
-  return -1;
+  if (!index) return -1;
+  vector<GroupIndex::Entry> hits;
+  index->tree.query(bgi::intersects(Point(x,y)), back_inserter(hits));
+
+  // of the (nested) groups containing (x,y), return the smallest
+  int r=-1;
+  float area=numeric_limits<float>::max();
+  for (vector<GroupIndex::Entry>::const_iterator i=hits.begin(); 
+       i!=hits.end(); ++i)
+    if (excluded.count(i->second)==0)
+      {
+        const Cell& c=index->cells.find(i->second)->second;
+        if (c.area<area || (c.area==area && i->second<r))
+          {
+            area=c.area;
+            r=i->second;
+          }
+      }
+  return r;
 }
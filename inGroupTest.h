@@ -21,10 +21,16 @@
 #define INGROUPTEST_H
 #include "groupIcon.h"
 #include <TCL_obj_base.h>
+#include <pack_base.h>
+#include <xml_pack_base.h>
+#include <xml_unpack_base.h>
 #include <map>
+#include <set>
 
 namespace minsky
 {
+  struct GroupIndex; // spatial index of groups, defined in inGroupTest.cc
+
   /// support for determining if a point (x,y) lies within a group,
   /// and if so, which one
   class InGroup
@@ -40,16 +46,26 @@ namespace minsky
       bool inRect(float x, float y) const {
         return x>=x0 && x<=x1 && y>=y0 && y<=y1;
       }
+      bool sameBounds(const Cell& x) const {
+        return x0==x.x0 && x1==x.x1 && y0==x.y0 && y1==x.y1 && area==x.area;
+      }
     };
-    typedef std::vector<std::vector<std::set<Cell> > > Cells;
        
   private:
-
-    float xmin, xmax, ymin, ymax, xBinSz, yBinSz;
-    Cells cells;
+    /// R-tree of group extents, kept between calls to initGroupList
+    classdesc::shared_ptr<GroupIndex> index;
+    std::set<int> excluded; ///< groups ignored by ContainingGroup
+    void copyIndex(const InGroup&);
     CLASSDESC_ACCESS(InGroup);
   public:
-    /// initialise with a collection of GroupIcons
+    InGroup() {}
+    InGroup(const InGroup& x): excluded(x.excluded) {copyIndex(x);}
+    InGroup& operator=(const InGroup& x) {
+      excluded=x.excluded; copyIndex(x); return *this;}
+
+    /// bring the index up to date with a collection of GroupIcons.
+    /// Only groups that have been added, deleted, moved, zoomed or
+    /// resized since the last call are reindexed.
     /// \a exclude specifies a group id to exclude from the test
     void initGroupList(const std::map<int, GroupIcon>&, int exclude=-1);
     /// return group containing (x,y) - if more than one group, then
@@ -60,5 +76,19 @@ namespace minsky
   };
 }
 
+// the index is derived data, and not serialised
+inline void pack(pack_t&, const std::string&,minsky::InGroup&) {}
+inline void unpack(pack_t&, const std::string&,minsky::InGroup&) {}
+inline void xml_pack(xml_pack_t&, const std::string&,minsky::InGroup&) {}
+inline void xml_unpack(xml_unpack_t&, const std::string&,minsky::InGroup&) {}
+
+#ifdef _CLASSDESC
+#pragma omit pack minsky::InGroup
+#pragma omit unpack minsky::InGroup
+#pragma omit xml_pack minsky::InGroup
+#pragma omit xml_unpack minsky::InGroup
+#pragma omit xsd_generate minsky::InGroup
+#endif
+
 #include "inGroupTest.cd"
 #endif
@@ -0,0 +1,68 @@
+/*
+  @copyright Steve Keen 2013
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef INDEXSTATE_H
+#define INDEXSTATE_H
+
+#include <pack_base.h>
+#include <xml_pack_base.h>
+#include <xml_unpack_base.h>
+#include <stddef.h>
+
+namespace minsky
+{
+  /**
+     Whether an index derived from one of the model's containers,
+     such as the wires attached to each port, reflects that
+     container. The index is built on demand, and mutators that
+     maintain it incrementally do so only while it is current. Any
+     other change to the container, including replacing an element
+     in place, must call invalidate().
+
+     Insertions and erasures made directly on the container are also
+     caught, as they change its size from that last recorded.
+  */
+  class IndexState
+  {
+    bool valid;
+    size_t indexed; ///< size of the container, as indexed
+  public:
+    IndexState(): valid(false), indexed(0) {}
+    /// true if the index reflects a container of \a size elements
+    bool current(size_t size) const {return valid && indexed==size;}
+    /// record that the index now reflects a container of \a size elements
+    void update(size_t size) {valid=true; indexed=size;}
+    void invalidate() {valid=false;}
+  };
+}
+
+inline void pack(pack_t&, const std::string&,minsky::IndexState&) {}
+inline void unpack(pack_t&, const std::string&,minsky::IndexState&) {}
+inline void xml_pack(xml_pack_t&, const std::string&,minsky::IndexState&) {}
+inline void xml_unpack(xml_unpack_t&, const std::string&,minsky::IndexState&) {}
+
+#ifdef _CLASSDESC
+#pragma omit pack minsky::IndexState
+#pragma omit unpack minsky::IndexState
+#pragma omit xml_pack minsky::IndexState
+#pragma omit xml_unpack minsky::IndexState
+#pragma omit xsd_generate minsky::IndexState
+#endif
+
+#include "indexState.cd"
+#endif
@@ -21,9 +21,12 @@
 #include "TCL_obj_stl.h"
 #include <gsl/gsl_errno.h>
 #include <gsl/gsl_odeiv2.h>
+#include <string.h>
 
 #include "minsky.h"
+#include "compiledModel.h"
 #include "cairoItems.h"
+#include "str.h"
 
 #include <schema/schema0.h>
 #include <schema/schema1.h>
@@ -42,6 +45,17 @@ namespace
     return true;
   }
 
+  /// pass the message of \a e back to the Tcl interpreter, unless
+  /// running on some other thread
+  void reportError(const std::exception& e)
+  {
+    if (Minsky::onTclThread())
+      {
+        Tcl_AppendResult(interp(),e.what(),NULL);
+        Tcl_AppendResult(interp(),"\n",NULL);
+      }
+  }
+
   /*
     For using GSL Runge-Kutta routines
   */
@@ -55,8 +69,7 @@ namespace
       }
     catch (std::exception& e)
       {
-        Tcl_AppendResult(interp(),e.what(),NULL);
-        Tcl_AppendResult(interp(),"\n",NULL);
+        reportError(e);
         return GSL_EBADFUNC;
       }
     return GSL_SUCCESS;
@@ -65,15 +78,50 @@ namespace
   int jacobian(double t, const double y[], double * dfdy, double dfdt[], void * params)
   {
     if (params==NULL) return GSL_EBADFUNC;
-        Minsky::Matrix jac(ValueVector::stockVars.size(), dfdy);
+    Minsky::Matrix jac(((Minsky*)params)->stockVars.size(), dfdy);
     try
       {
         ((Minsky*)params)->jacobian(jac,y);
+        ((Minsky*)params)->timeDerivative(dfdt,y);
       }
      catch (std::exception& e)
       {
-        Tcl_AppendResult(interp(),e.what(),NULL);
-        Tcl_AppendResult(interp(),"\n",NULL);
+        reportError(e);
+        return GSL_EBADFUNC;
+      }   
+    return GSL_SUCCESS;
+  }
+
+  // versions of the above using native code
+  int compiledFunction(double t, const double y[], double f[], void *params)
+  {
+    if (params==NULL) return GSL_EBADFUNC;
+    try
+      {
+        Minsky& m=*(Minsky*)params;
+        m.compiledModel->evalEquations(m,f,y);
+      }
+    catch (std::exception& e)
+      {
+        reportError(e);
+        return GSL_EBADFUNC;
+      }
+    return GSL_SUCCESS;
+  }
+
+  int compiledJacobian(double t, const double y[], double * dfdy, double dfdt[], void * params)
+  {
+    if (params==NULL) return GSL_EBADFUNC;
+    Minsky::Matrix jac(((Minsky*)params)->stockVars.size(), dfdy);
+    try
+      {
+        Minsky& m=*(Minsky*)params;
+        m.compiledModel->jacobian(m,jac,y);
+        m.timeDerivative(dfdt,y);
+      }
+    catch (std::exception& e)
+      {
+        reportError(e);
         return GSL_EBADFUNC;
       }   
     return GSL_SUCCESS;
@@ -83,25 +131,44 @@ namespace
 namespace minsky
 {
 
+  const gsl_odeiv2_step_type* stepType(OdeStepper::Type stepper)
+  {
+    switch (stepper)
+      {
+      case OdeStepper::rkf45: return gsl_odeiv2_step_rkf45;
+      case OdeStepper::rkck: return gsl_odeiv2_step_rkck;
+      case OdeStepper::rk8pd: return gsl_odeiv2_step_rk8pd;
+      case OdeStepper::rk4imp: return gsl_odeiv2_step_rk4imp;
+      case OdeStepper::bsimp: return gsl_odeiv2_step_bsimp;
+      case OdeStepper::msbdf: return gsl_odeiv2_step_msbdf;
+      default:
+        throw error("unknown ODE stepper %s", 
+                    OdeStepper::typeName(stepper).c_str());
+      }
+  }
+
   struct RKdata
   {
     gsl_odeiv2_system sys;
     gsl_odeiv2_driver* driver;
     RKdata(Minsky* minsky) {
-      sys.function=function;
-      sys.jacobian=jacobian;
-      sys.dimension=ValueVector::stockVars.size();
+      if (minsky->compiledModel)
+        {
+          sys.function=compiledFunction;
+          sys.jacobian=compiledJacobian;
+        }
+      else
+        {
+          sys.function=function;
+          sys.jacobian=jacobian;
+        }
+      sys.dimension=minsky->stockVars.size();
       sys.params=minsky;
+      // implicit methods are better for stiffer systems, and make
+      // use of the jacobian
       driver = gsl_odeiv2_driver_alloc_y_new
-        (&sys, gsl_odeiv2_step_rkf45, minsky->stepMax, minsky->epsAbs, 
+        (&sys, stepType(minsky->stepper), minsky->stepMax, minsky->epsAbs, 
          minsky->epsRel);
-      // TODO: implicit methods are better for stiffer systems, but
-      // require the jacobian (which I've taken special care to
-      // provide). Make as a user option to select solver order, and
-      // whether implicit or explicit methods are used.
-//      driver = gsl_odeiv2_driver_alloc_y_new
-//        (&sys, gsl_odeiv2_step_rk4imp, minsky->stepMax, minsky->epsAbs, 
-//         minsky->epsRel);
       gsl_odeiv2_driver_set_hmax(driver, minsky->stepMax);
       gsl_odeiv2_driver_set_hmin(driver, minsky->stepMin);
     }
@@ -116,11 +183,18 @@ namespace minsky
 
 
 #include <algorithm>
+#include <pthread.h>
 using namespace std;
 
+string OdeStepper::typeName(int t) 
+{return enumKey<Type>(t);}
+
 namespace 
 {
-  Minsky* l_minsky=NULL;
+  // each thread may work on its own model
+  __thread Minsky* l_minsky=NULL;
+  // the Tcl interpreter belongs to the thread that loaded Minsky
+  const pthread_t tclThread=pthread_self();
 }
 
 namespace minsky
@@ -134,13 +208,53 @@ namespace minsky
       return s_minsky;
   }
 
-  LocalMinsky::LocalMinsky(Minsky& minsky) {l_minsky=&minsky;}
-  LocalMinsky::~LocalMinsky() {l_minsky=NULL;}
+  LocalMinsky::LocalMinsky(Minsky& minsky): prev(l_minsky) {l_minsky=&minsky;}
+  LocalMinsky::~LocalMinsky() {l_minsky=prev;}
+
+  // canvas items are edited from TCL through the var, op, constant,
+  // integral, groupItem, wire, plot and godleyItem proxies. Calls
+  // that can change the proxied item report it to the scene index
+  // and canvas journal: those with arguments, other than get, which
+  // selects the item, and the few mutators taking no arguments. The
+  // groupItem, wire, plot and godleyItem proxies hold copies, written
+  // back by set.
+  void touchProxiedItem(Minsky& m, int argc, const char* cmd)
+  {
+    // cmd is of the form [minsky.]proxy.member
+    const char* member=strrchr(cmd, '.');
+    if (!member || member==cmd) return;
+    ++member;
+    if (argc>1? strcmp(member,"get")==0:
+        strcmp(member,"set")!=0 && strcmp(member,"toggleCoupled")!=0 &&
+        strcmp(member,"computeDisplayZoom")!=0)
+      return;
+    const char* start=member-1;
+    while (start>cmd && start[-1]!='.') --start;
+    string proxy(start, member-1);
+    if (proxy=="var")
+      m.touched(gotten(m.var));
+    else if (proxy=="op")
+      m.touched(gotten(m.op));
+    else if (proxy=="constant")
+      m.touched(static_cast<const OperationBase*>(gotten(m.constant)));
+    else if (proxy=="integral")
+      m.touched(static_cast<const OperationBase*>(gotten(m.integral)));
+    else if (proxy=="groupItem")
+      m.touched
+        (SceneIndex::Item(SceneIndex::Item::group, m.groupItem.key));
+    else if (proxy=="wire")
+      m.canvasJournal.touched(ChangeJournal::wire, str(m.wire.key));
+    else if (proxy=="plot")
+      m.canvasJournal.touched(ChangeJournal::plot, m.plot.key);
+    else if (proxy=="godleyItem")
+      m.canvasJournal.touched(ChangeJournal::godley, str(m.godleyItem.key));
+  }
 
   // a hook for recording when the minsky model's state changes
   void member_entry_hook(int argc, CONST84 char** argv)
   {
     if (argc>1) minsky().markEdited();
+    touchProxiedItem(minsky(), argc, argv[0]);
   }
 
   TCL_obj_t& minskyTCL_obj() 
@@ -160,26 +274,45 @@ namespace minsky
 
 
   Minsky::Minsky(): reset_needed(true), m_zoomFactor(1),
-                    port(ports), wire(wires), op(operations), 
-                    constant(operations), integral(operations), var(variables),
+                    port(ports, &portsIndexed), wire(wires, &wiresIndexed),
+                    op(operations), constant(operations), 
+                    integral(operations), var(variables),
                     value(variables.values), plot(plots.plots), 
                     godleyItem(godleyItems), groupItem(groupItems),
                     t(0), stepMin(0), stepMax(0.1), nSteps(1),
-                    epsAbs(1e-3), epsRel(1e-2) 
+                    epsAbs(1e-3), epsRel(1e-2), stepper(OdeStepper::rkf45),
+                    useCompiledModel(false), nThreads(1), 
+                    parallelThreshold(1000)
   {
     m_edited=false; // needs to be here, because the GodleyIcon constructor calls markEdited
   }
 
+  void MinskyExclude::touched(const SceneIndex::Item& item)
+  {
+    sceneIndex.touched(item);
+    ChangeJournal::Kind kind=ChangeJournal::var;
+    switch (item.kind)
+      {
+      case SceneIndex::Item::variable: kind=ChangeJournal::var; break;
+      case SceneIndex::Item::operation: kind=ChangeJournal::op; break;
+      case SceneIndex::Item::group: kind=ChangeJournal::groupItem; break;
+      }
+    canvasJournal.touched(kind, str(item.id));
+  }
+
   void Minsky::clearAllMaps()
   {
     wires.clear(); 
+    wiresChanged();
     ports.clear();
+    portsChanged();
     godleyItems.clear();
     operations.clear();
     variables.clear();
     variables.values.clear();
     groupItems.clear();
     plots.clear();
+    canvasInvalidated();
     
     flowVars.clear();
     stockVars.clear();
@@ -257,6 +390,8 @@ namespace minsky
     if (!newOp) return -1;
     int id=operations.empty()? 0: operations.rbegin()->first+1;
     operations.insert(make_pair(id, newOp));
+    variables.integralsChanged();
+    touched(SceneIndex::Item(SceneIndex::Item::operation, id));
     markEdited();
     return id;
   }
@@ -268,6 +403,8 @@ namespace minsky
     int newId=operations.empty()? 0: operations.rbegin()->first+1;
     OperationPtr newOp = source->second->clone();
     operations.insert(make_pair(newId, newOp));
+    variables.integralsChanged();
+    touched(SceneIndex::Item(SceneIndex::Item::operation, newId));
     markEdited();
     return newId;
   }
@@ -281,7 +418,8 @@ namespace minsky
         // delete all wires attached to this operation
         for (int p=0; p<op->second->numPorts(); ++p)
           {
-            array<int> wires=WiresAttachedToPort(op->second->ports()[p]);
+            // copied, as wires are deleted while traversing it
+            WireIds wires=WiresAttachedToPort(op->second->ports()[p]);
             for (int w=0; w<wires.size(); ++w)
               {
                 int wid=wires[w];
@@ -290,6 +428,8 @@ namespace minsky
               }
           }
         operations.erase(op);
+        variables.integralsChanged();
+        touched(SceneIndex::Item(SceneIndex::Item::operation, opid));
         // ticket #199, remove references held by getter/setter
         this->op.clear();
         integral.clear();
@@ -306,6 +446,7 @@ namespace minsky
     if (g.empty())
       {
         groupItems.erase(id);
+        touched(SceneIndex::Item(SceneIndex::Item::group, id));
         return -1;
       }
     markEdited();
@@ -316,6 +457,7 @@ namespace minsky
   {
     groupItems[id].ungroup();
     groupItems.erase(id);
+    touched(SceneIndex::Item(SceneIndex::Item::group, id));
     markEdited();
   }
 
@@ -327,6 +469,7 @@ namespace minsky
     GroupIcon& g=
       groupItems.insert(make_pair(newId, GroupIcon(newId))).first->second;
     g.copy(srcIt->second);
+    touched(SceneIndex::Item(SceneIndex::Item::group, newId));
     markEdited();
     return newId;
   }
@@ -345,6 +488,7 @@ namespace minsky
     GroupIcon& g=
       groupItems.insert(make_pair(newId, GroupIcon(newId))).first->second;
     currentSchema.populateGroup(g);
+    canvasInvalidated();
     return newId;
   }
 
@@ -383,46 +527,7 @@ namespace minsky
     for (int i=0; i<stockVars.size(); ++i)
       assert(sv[i]==0);
 #endif
-    for (GodleyItems::iterator gi=godleyItems.begin(); 
-         gi!=godleyItems.end(); ++gi)
-      {
-        GodleyTable& godley=gi->second.table;
-        for (int c=1; c<godley.cols(); ++c)
-          {
-            string name=godley.cell(0,c);
-            stripNonAlnum(name);
-            VariableValue& stockVar=variables.getVariableValue(name);
-            if (stockVar.idx()<0) continue; //variable undefined
-            assert(stockVar.idx()<stockVars.size());
-
-            for (int r=1; r<godley.rows(); ++r)
-              {
-                if (godley.initialConditionRow(r)) continue;
-                const string& formula = godley.cell(r,c);
-                size_t start=0;
-                while (start<formula.length() && isspace(formula[start])) start++;
-                if (start<formula.length())
-                  {
-                    // for the moment, only deal with signed variables
-                    string name=formula; stripNonAlnum(name);
-                    VariableValue& var=variables.getVariableValue(name);
-                    if (var.idx()<0) continue;
-                    assert(var.idx()<flowVars.size());
-                    if (godley.signConventionReversed(c))
-                      // we must reverse the sign convention
-                      if (formula[start]=='-')
-                        sv[stockVar.idx()]+=fv[var.idx()];
-                      else
-                        sv[stockVar.idx()]-=fv[var.idx()];
-                    else
-                      if (formula[start]=='-')
-                        sv[stockVar.idx()]-=fv[var.idx()];
-                      else
-                        sv[stockVar.idx()]+=fv[var.idx()];
-                  }
-              }
-          }
-      }
+    godleyIncidence.apply(sv, fv);
   }
 
 
@@ -460,32 +565,75 @@ namespace minsky
     for (Plots::Map::iterator pl=plots.plots.begin(); pl!=plots.plots.end(); ++pl)
       for (int p=0; p<pl->second.ports.size(); ++p)
         ports[pl->second.ports[p]] = oldPortMap[pl->second.ports[p]];
+    portsChanged();
 
     variables.reset();
   }
 
   namespace {
 
-    // perform depth first ranking of nodes in a graph by level. Graph
-    // is assumed to be acyclic
+    // rank the nodes of a graph reachable from a set of sources by
+    // level, being the length of the longest path to them from a
+    // source. Each node and link is visited once, as a depth first
+    // ranking revisits a node along every path leading to it, which
+    // grows exponentially with the depth of large models.
     struct OperationOrderer
     {
       map<int,int> opOrder; // order by operation
       map<int,vector<int> > links; // links in the execution graph
-      set<int> visited; //keep track of nodes in stack
+      set<int> sources;
 
-      void order(int node, int level) 
+      void order(int node) {sources.insert(node);}
+
+      const vector<int>& successors(int node) const
       {
-        int& currentLevel = opOrder[node];
-        if (currentLevel < level)
-          currentLevel=level;
-        // check for cycles
-        if (!visited.insert(node).second)
+        static const vector<int> none;
+        map<int,vector<int> >::const_iterator l=links.find(node);
+        return l==links.end()? none: l->second;
+      }
+
+      /// fill in opOrder
+      /// @throws ecolab::error if the reachable graph is cyclic
+      void rank()
+      {
+        // count the links into each reachable node
+        map<int,int> inDegree;
+        vector<int> stack(sources.begin(), sources.end());
+        for (size_t i=0; i<stack.size(); ++i)
+          inDegree[stack[i]];
+        while (!stack.empty())
+          {
+            const vector<int>& ll=successors(stack.back());
+            stack.pop_back();
+            for (vector<int>::const_iterator l=ll.begin(); l!=ll.end(); ++l)
+              if (inDegree[*l]++==0 && !sources.count(*l))
+                stack.push_back(*l);
+          }
+
+        // then assign levels in topological order
+        for (map<int,int>::iterator n=inDegree.begin(); n!=inDegree.end(); ++n)
+          if (n->second==0)
+            {
+              stack.push_back(n->first);
+              opOrder[n->first]=1;
+            }
+        size_t nRanked=0;
+        for (; !stack.empty(); ++nRanked)
+          {
+            int node=stack.back();
+            stack.pop_back();
+            int level=opOrder[node]+1;
+            const vector<int>& ll=successors(node);
+            for (vector<int>::const_iterator l=ll.begin(); l!=ll.end(); ++l)
+              {
+                int& currentLevel=opOrder[*l];
+                if (currentLevel<level) currentLevel=level;
+                if (--inDegree[*l]==0)
+                  stack.push_back(*l);
+              }
+          }
+        if (nRanked<inDegree.size())
           throw error("cyclic network detected");
-        vector<int>& ll=links[node];
-        for (vector<int>::iterator l=ll.begin(); l!=ll.end(); ++l)
-          order(*l, level+1);
-        visited.erase(node);
       }
     };
 
@@ -642,6 +790,7 @@ namespace minsky
 
   void Minsky::constructEquations()
   {
+    LocalMinsky lm(*this);
     if (cycleCheck()) throw error("cyclic network detected");
     garbageCollect();
     equations.clear();
@@ -688,19 +837,20 @@ namespace minsky
       if (!variables.InputWired(v->second->Name()) || 
           v->second->type()==VariableType::integral)
         {
-          array<int> attachedWires = WiresAttachedToPort(v->second->outPort());
+          const WireIds& attachedWires = WiresAttachedToPort(v->second->outPort());
           for (int w=0; w<attachedWires.size(); ++w)
             {
               map<int,int>::iterator i=operationIdFromInputsPort.
                 find(wires[attachedWires[w]].to);
               if (i!=operationIdFromInputsPort.end())
-                operationOrder.order(i->second, 1);
+                operationOrder.order(i->second);
             }
         }
 
     // now add in the source operations
     for (size_t i=0; i<sourceOperations.size(); ++i)
-      operationOrder.order(sourceOperations[i], 1);
+      operationOrder.order(sourceOperations[i]);
+    operationOrder.rank();
 
     vector<pair<int,int> > orderedOperations
       (operationOrder.opOrder.begin(), operationOrder.opOrder.end());
@@ -792,7 +942,7 @@ namespace minsky
         EvalOpPtr e(op->type(), -1);
         e->state=op;
 
-        array<int> outgoingWires = WiresAttachedToPort(op->ports()[0]);
+        const WireIds& outgoingWires = WiresAttachedToPort(op->ports()[0]);
         
         VariableValue v;
 
@@ -870,31 +1020,121 @@ namespace minsky
       }
     for (EvalOpVector::iterator e=equations.begin(); e!=equations.end(); ++e)
       (*e)->reset();
+    tape.compile(equations);
+    // named variables, integral inputs and plot inputs must be kept
+    // up to date by the optimised tape
+    vector<bool> observed(flowVars.size());
+    for (VariableManager::VariableValues::const_iterator v=variables.values.begin();
+         v!=variables.values.end(); ++v)
+      if (v->second.lhs() && v->second.idx()>=0)
+        observed[v->second.idx()]=true;
+    for (vector<Integral>::const_iterator i=integrals.begin(); 
+         i!=integrals.end(); ++i)
+      if (i->input.lhs() && i->input.idx()>=0)
+        observed[i->input.idx()]=true;
+    // plots read pen and range inputs directly from their slots,
+    // which may be temporaries of operations wired to the plot
+    for (Plots::Map::const_iterator i=plots.plots.begin(); 
+         i!=plots.plots.end(); ++i)
+      for (size_t p=0; p<i->second.ports.size(); ++p)
+        {
+          map<int,VariableValue>::const_iterator v=
+            inputFrom.find(i->second.ports[p]);
+          if (v!=inputFrom.end() && v->second.lhs() && v->second.idx()>=0)
+            observed[v->second.idx()]=true;
+        }
+    tape.optimise(flowVars, observed);
+    tape.schedule();
+
+    godleyIncidence.compile(godleyItems, variables, stockVars.size());
+
+    // stock derivatives depend on the flows named in their Godley
+    // table column, and on the inputs of their integrals
+    vector<pair<int,int> > flowInputs, stockInputs;
+    for (size_t s=0; s+1<godleyIncidence.rowStart.size(); ++s)
+      for (int p=godleyIncidence.rowStart[s]; p<godleyIncidence.rowStart[s+1]; ++p)
+        flowInputs.push_back(make_pair(s, godleyIncidence.flow[p]));
+    for (vector<Integral>::iterator i=integrals.begin(); 
+         i!=integrals.end(); ++i)
+      (i->input.lhs()? flowInputs: stockInputs).push_back
+        (make_pair(i->stock.idx(), i->input.idx()));
+    jacobianPattern.build(tape, stockVars.size(), flowVars.size(),
+                          flowInputs, stockInputs);
   }
 
   void Minsky::reset()
   {
+    LocalMinsky lm(*this);
     constructEquations();
     // if no stock variables in system, add a dummy stock variable to
     // make the simulation proceed
     if (stockVars.empty()) stockVars.resize(1,0);
 
     plots.reset(variables);
+    recorder.bind(variables);
     t=0;
 
+    if (useCompiledModel)
+      compiledModel.reset(new CompiledModel(*this));
+    else
+      compiledModel.reset();
+
+    if (nThreads>1)
+      {
+        if (!threadPool || int(threadPool->size())!=nThreads)
+          threadPool.reset(new ThreadPool(nThreads));
+      }
+    else
+      threadPool.reset();
+
     if (stockVars.size()>0)
       ode.reset(new RKdata(this));
   }
 
+  void Minsky::initEnsemble(int nLanes)
+  {
+    if (reset_needed) 
+      {
+        reset();
+        reset_needed=false;
+      }
+    ensemble.init(tape, godleyIncidence, stockVars, flowVars, nLanes, t);
+    for (vector<Integral>::iterator i=integrals.begin(); i<integrals.end(); ++i)
+      {
+        if (i->input.idx()<0)
+          throw error("integral not wired");
+        ensemble.addIntegral(i->stock.idx(), i->input.idx(), i->input.lhs());
+      }
+  }
+
+  void Minsky::setEnsembleParameter(int id, int lane, double value)
+  {
+    Operations::const_iterator op=operations.find(id);
+    if (op==operations.end() || op->second->type()!=OperationType::constant)
+      throw error("operation %d is not a constant", id);
+    ensemble.setParameter(op->second, lane, value);
+  }
+
+  double Minsky::ensembleValue(const string& name, int lane) const
+  {
+    VariableManager::VariableValues::const_iterator v=variables.values.find(name);
+    if (v==variables.values.end() || v->second.idx()<0)
+      throw error("variable %s has no value", name.c_str());
+    if (lane<0 || lane>=int(ensemble.nLanes))
+      throw error("lane %d out of range", lane);
+    return v->second.lhs()? ensemble.flow(v->second.idx(), lane):
+      ensemble.stock(v->second.idx(), lane);
+  }
+
   void Minsky::step()
   {
+    LocalMinsky lm(*this);
     if (reset_needed) 
       {
         reset();
         reset_needed=false;
         // update flow variable
-        for (size_t i=0; i<equations.size(); ++i)
-          equations[i]->eval(&flowVars[0], &stockVars[0]);
+        evalFlowVars(&flowVars[0], &stockVars[0]);
       }
 
 
@@ -919,11 +1159,13 @@ namespace minsky
       }
 
     // update flow variables
-    for (size_t i=0; i<equations.size(); ++i)
-      equations[i]->eval(&flowVars[0], &stockVars[0]);
+    evalFlowVars(&flowVars[0], &stockVars[0]);
 
     for (Plots::Map::iterator i=plots.plots.begin(); i!=plots.plots.end(); ++i)
       i->second.addPlotPt(t);
+
+    if (recorder.recording())
+      recorder.record(t);
   }
 
   string Minsky::diagnoseNonFinite() const
@@ -941,13 +1183,27 @@ namespace minsky
     return "";
   }
 
+  void Minsky::evalFlowVars(double fv[], const double sv[])
+  {
+    int bad=threadPool? tape.eval(fv, sv, t, *threadPool, parallelThreshold):
+      tape.eval(fv, sv, t);
+    if (bad>=0)
+      {
+        // rerun the unoptimised equations to generate the diagnostic
+        for (size_t i=0; i<equations.size(); ++i)
+          equations[i]->eval(fv, sv);
+        throw error("Invalid: %s",
+                    OperationType::typeName(tape.opcode[bad]).c_str());
+      }
+  }
+
   void Minsky::evalEquations(double result[], const double vars[])
   {
     // firstly evaluate the flow variables. Initialise to flowVars so
     // that no input vars are correctly initialised
-    vector<double> flow(flowVars);
-    for (size_t i=0; i<equations.size(); ++i)
-      equations[i]->eval(&flow[0], vars);
+    vector<double>& flow=scratch.flow;
+    flow=flowVars;
+    evalFlowVars(&flow[0], vars);
 
     // then create the result using the Godley table
     for (size_t i=0; i<stockVars.size(); ++i) result[i]=0;
@@ -966,34 +1222,281 @@ namespace minsky
       }
   }
 
+  void Minsky::stockTangent(double d[], size_t lane)
+  {
+    // Godley tables and integrals are linear, so are applied one
+    // direction at a time
+    const size_t w=EvalTape::derivWidth;
+    const vector<double>& df=scratch.df, &ds=scratch.ds;
+    vector<double>& dfLane=scratch.dfLane;
+    dfLane.resize(flowVars.size());
+    for (size_t i=0; i<dfLane.size(); ++i)
+      dfLane[i]=df[i*w+lane];
+    for (size_t i=0; i<stockVars.size(); ++i)
+      d[i]=0;
+    godleyEval(d, &dfLane[0]);
+    for (vector<Integral>::iterator i=integrals.begin(); 
+         i!=integrals.end(); ++i)
+      {
+        assert(i->stock.idx()>=0 && i->input.idx()>=0);
+        d[i->stock.idx()] = i->input.lhs()? 
+          dfLane[i->input.idx()]: ds[i->input.idx()*w+lane];
+      }
+  }
+
   void Minsky::jacobian(Matrix& jac, const double sv[])
   {
     // firstly evaluate the flow variables. Initialise to flowVars so
     // that no input vars are correctly initialised
-    vector<double> flow=flowVars;
-    for (size_t i=0; i<equations.size(); ++i)
-      equations[i]->eval(&flow[0], sv);
+    vector<double>& flow=scratch.flow;
+    flow=flowVars;
+    evalFlowVars(&flow[0], sv);
+
+    // then propagate the tangents of EvalTape::derivWidth stock
+    // variables at a time through the equations
+    const size_t w=EvalTape::derivWidth, nStocks=stockVars.size();
+    vector<double>& ds=scratch.ds, &df=scratch.df, &d=scratch.d;
+    ds.assign(nStocks*w, 0);
+    d.resize(nStocks);
+
+    for (size_t j0=0; j0<nStocks; j0+=w)
+      {
+        size_t nLanes=min(w, nStocks-j0);
+        for (size_t k=0; k<nLanes; ++k)
+          ds[(j0+k)*w+k]=1;
+        df.assign(flowVars.size()*w, 0);
+        int bad=tape.deriv(&df[0], &ds[0], sv, &flow[0]);
+        if (bad>=0)
+          throw error("Invalid operation detected on a %s operation",
+                      OperationType::typeName(tape.opcode[bad]).c_str());
+
+        for (size_t k=0; k<nLanes; ++k)
+          {
+            stockTangent(&d[0], k);
+            for (size_t i=0; i<nStocks; i++)
+              jac(i,j0+k)=d[i];
+          }
+
+        for (size_t k=0; k<nLanes; ++k)
+          ds[(j0+k)*w+k]=0;
+      }
+  }
 
-    // then determine the derivatives with respect to variable j
-    for (size_t j=0; j<stockVars.size(); ++j)
+  void Minsky::sparseJacobian(SparseMatrix& jac, const double sv[])
+  {
+    const JacobianPattern& pattern=jacobianPattern;
+    const size_t w=EvalTape::derivWidth, nStocks=pattern.n;
+    assert(nStocks==stockVars.size());
+    jac.n=nStocks;
+    jac.rowStart=pattern.rowStart;
+    jac.col=pattern.col;
+    jac.value.resize(jac.col.size());
+
+    vector<double>& flow=scratch.flow;
+    flow=flowVars;
+    evalFlowVars(&flow[0], sv);
+
+    // each tangent lane seeds all the columns of one colour
+    vector<double>& ds=scratch.ds, &df=scratch.df, &d=scratch.d;
+    d.resize(nStocks*w);
+
+    for (int c0=0; c0<pattern.nColours; c0+=w)
       {
-        vector<double> ds(stockVars.size()), df(flowVars.size());
-        ds[j]=1;
-        for (size_t i=0; i<equations.size(); ++i)
-          equations[i]->deriv(&df[0], &ds[0], sv, &flow[0]);
-        vector<double> d(stockVars.size());
-        godleyEval(&d[0], &df[0]);
-        for (vector<Integral>::iterator i=integrals.begin(); 
-             i!=integrals.end(); ++i)
+        int nLanes=min(int(w), pattern.nColours-c0);
+        ds.assign(nStocks*w, 0);
+        for (size_t j=0; j<nStocks; ++j)
+          if (pattern.colour[j]>=c0 && pattern.colour[j]<c0+nLanes)
+            ds[j*w+pattern.colour[j]-c0]=1;
+        df.assign(flowVars.size()*w, 0);
+        int bad=tape.deriv(&df[0], &ds[0], sv, &flow[0]);
+        if (bad>=0)
+          throw error("Invalid operation detected on a %s operation",
+                      OperationType::typeName(tape.opcode[bad]).c_str());
+
+        for (int k=0; k<nLanes; ++k)
+          stockTangent(&d[k*nStocks], k);
+
+        // row i of a column of colour c is row i of the tangent of c
+        for (size_t i=0; i<nStocks; ++i)
+          for (int p=jac.rowStart[i]; p<jac.rowStart[i+1]; ++p)
+            {
+              int k=pattern.colour[jac.col[p]]-c0;
+              if (k>=0 && k<nLanes)
+                jac.value[p]=d[k*nStocks+i];
+            }
+      }
+  }
+
+  void Minsky::timeDerivative(double dfdt[], const double sv[])
+  {
+    vector<double>& flow=scratch.flow;
+    flow=flowVars;
+    evalFlowVars(&flow[0], sv);
+
+    // a single tangent direction along time, with stocks held fixed
+    const size_t w=EvalTape::derivWidth;
+    double dt[w]={1};
+    scratch.ds.assign(stockVars.size()*w, 0);
+    scratch.df.assign(flowVars.size()*w, 0);
+    int bad=tape.deriv(&scratch.df[0], &scratch.ds[0], sv, &flow[0], dt);
+    if (bad>=0)
+      throw error("Invalid operation detected on a %s operation",
+                  OperationType::typeName(tape.opcode[bad]).c_str());
+    stockTangent(dfdt, 0);
+  }
+
+  namespace
+  {
+    const char checkpointMagic[]="MinskyCheckpoint";
+    const int checkpointVersion=4;
+
+    /// values of the named flow (or stock) variables of a model, keyed
+    /// by name. Slot numbers depend on the history of edits to the
+    /// model, so are not stored in checkpoints
+    struct NamedValues
+    {
+      vector<string> names;
+      vector<double> values;
+      NamedValues() {}
+      NamedValues(const VariableManager& variables, 
+                  const vector<double>& slots, bool flows)
+      {
+        for (VariableManager::VariableValues::const_iterator v=
+               variables.values.begin(); v!=variables.values.end(); ++v)
+          if (v->second.idx()>=0 && v->second.lhs()==flows)
+            {
+              names.push_back(v->first);
+              values.push_back(slots[v->second.idx()]);
+            }
+      }
+      /// write the values into \a slots of \a variables
+      /// @return false if the variables do not have the same names
+      bool assignTo(const VariableManager& variables, 
+                    vector<double>& slots, bool flows) const
+      {
+        if (NamedValues(variables, slots, flows).names!=names ||
+            values.size()!=names.size())
+          return false;
+        size_t i=0;
+        for (VariableManager::VariableValues::const_iterator v=
+               variables.values.begin(); v!=variables.values.end(); ++v)
+          if (v->second.idx()>=0 && v->second.lhs()==flows)
+            slots[v->second.idx()]=values[i++];
+        return true;
+      }
+    };
+
+    /// first bytes of a binary model file
+    const char binaryModelMagic[8]={'M','I','N','S','K','Y','B','\0'};
+    const int binaryModelVersion=1;
+
+    /// read the contents of \a filename from \a offset into \a buf
+    void readFile(const char* filename, pack_t& buf, size_t offset=0)
+    {
+      vector<char> data;
+      FILE* f=fopen(filename, "rb");
+      if (!f) throw error("cannot open %s", filename);
+      char block[8192];
+      for (size_t n; (n=fread(block, 1, sizeof(block), f))>0;)
+        data.insert(data.end(), block, block+n);
+      fclose(f);
+      if (data.size()<=offset) throw error("%s is empty", filename);
+      buf.packraw(&data[offset], data.size()-offset);
+    }
+
+    /// write \a header followed by \a buf to \a filename
+    void writeFile(const char* filename, const pack_t& buf, 
+                   const char* header=NULL, size_t headerSize=0)
+    {
+      FILE* f=fopen(filename, "wb");
+      if (!f) throw error("cannot create %s", filename);
+      bool ok=fwrite(header, 1, headerSize, f)==headerSize &&
+        fwrite(buf.data(), 1, buf.size(), f)==buf.size();
+      if (fclose(f)!=0 || !ok)
+        throw error("error writing %s", filename);
+    }
+  }
+
+  void Minsky::checkpoint(const char* filename)
+  {
+    LocalMinsky lm(*this);
+    if (reset_needed) 
+      {
+        reset();
+        reset_needed=false;
+      }
+    pack_t buf;
+    buf<<string(checkpointMagic)<<checkpointVersion;
+    NamedValues stocks(variables, stockVars, false), 
+      flows(variables, flowVars, true);
+    buf<<stocks.names<<stocks.values<<flows.names<<flows.values<<t;
+    // the GSL driver's internal stepper state is not accessible, but
+    // the step size it has adapted to is
+    double h=ode? ode->driver->h: 0;
+    buf<<h;
+    buf<<plots.plots.size();
+    for (Plots::Map::iterator p=plots.plots.begin(); p!=plots.plots.end(); ++p)
+      buf<<p->first<<static_cast<ecolab::Plot&>(p->second)
+         <<plotLOD(p->second);
+
+    writeFile(filename, buf);
+  }
+
+  void Minsky::restore(const char* filename)
+  {
+    LocalMinsky lm(*this);
+    pack_t buf;
+    readFile(filename, buf);
+
+    string magic;
+    int version=0;
+    buf>>magic>>version;
+    if (magic!=checkpointMagic || version!=checkpointVersion)
+      throw error("%s is not a Minsky checkpoint", filename);
+
+    // construct the equations, then overwrite their state
+    if (reset_needed) 
+      {
+        reset();
+        reset_needed=false;
+      }
+    NamedValues stocks, flows;
+    double checkpointT, h;
+    buf>>stocks.names>>stocks.values>>flows.names>>flows.values
+       >>checkpointT>>h;
+    vector<double> sv(stockVars), fv(flowVars);
+    if (!stocks.assignTo(variables, sv, false) || 
+        !flows.assignTo(variables, fv, true))
+      throw error("checkpoint %s does not match this model", filename);
+    stockVars.swap(sv);
+    flowVars.swap(fv);
+    t=checkpointT;
+    if (ode)
+      {
+        gsl_odeiv2_driver_reset(ode->driver);
+        if (h>0) gsl_odeiv2_driver_reset_hstart(ode->driver, h);
+      }
+
+    size_t nPlots;
+    buf>>nPlots;
+    for (size_t i=0; i<nPlots; ++i)
+      {
+        string name;
+        buf>>name;
+        Plots::Map::iterator p=plots.plots.find(name);
+        if (p!=plots.plots.end())
+          {
+            buf>>static_cast<ecolab::Plot&>(p->second)
+               >>plotLOD(p->second);
+            p->second.redraw();
+          }
+        else
           {
-            assert(i->stock.idx()>=0 && i->input.idx()>=0);
-            d[i->stock.idx()] = 
-              i->input.lhs()? df[i->input.idx()]: ds[i->input.idx()];
+            ecolab::Plot discard;
+            vector<PlotLOD> discardLOD;
+            buf>>discard>>discardLOD;
           }
-        for (size_t i=0; i<stockVars.size(); i++)
-          jac(i,j)=d[i];
       }
-  
   }
 
   void Minsky::Save(const char* filename) 
@@ -1006,6 +1509,30 @@ namespace minsky
     m_edited=false;
   }
 
+  void Minsky::SaveBinary(const char* filename) 
+  {
+    garbageCollect();
+    pack_t buf;
+    // the format is native, so record enough to detect a mismatch
+    int version=binaryModelVersion, sizeofSize=sizeof(size_t);
+    double one=1;
+    buf<<version<<sizeofSize<<one;
+    schema1::Minsky(*this).packBinary(buf);
+    writeFile(filename, buf, binaryModelMagic, sizeof(binaryModelMagic));
+    m_edited=false;
+  }
+
+  bool Minsky::isBinaryModel(const char* filename)
+  {
+    char magic[sizeof(binaryModelMagic)];
+    FILE* f=fopen(filename, "rb");
+    if (!f) return false;
+    bool r=fread(magic, 1, sizeof(magic), f)==sizeof(magic) &&
+      memcmp(magic, binaryModelMagic, sizeof(magic))==0;
+    fclose(f);
+    return r;
+  }
+
 namespace
 {
   // comparison operation used for removing duplicate wires
@@ -1028,9 +1555,29 @@ namespace
 
     // current schema
     schema1::Minsky currentSchema;
-    ifstream inf(filename);
-    xml_unpack_t saveFile(inf);
-    xml_unpack(saveFile, "Minsky", currentSchema);
+    if (isBinaryModel(filename))
+      {
+        pack_t buf;
+        readFile(filename, buf, sizeof(binaryModelMagic));
+        int version, sizeofSize;
+        double one;
+        buf>>version>>sizeofSize>>one;
+        if (version!=binaryModelVersion)
+          throw error("unsupported binary model version %d", version);
+        if (sizeofSize!=int(sizeof(size_t)) || one!=1)
+          throw error("binary model %s was written on an incompatible "
+                      "platform. Convert it to XML there.", filename);
+        currentSchema.unpackBinary(buf);
+        if (currentSchema.schemaVersion!=currentSchema.version)
+          throw error("unsupported schema version %d in %s", 
+                      currentSchema.schemaVersion, filename);
+      }
+    else
+      {
+        ifstream inf(filename);
+        xml_unpack_t saveFile(inf);
+        xml_unpack(saveFile, "Minsky", currentSchema);
+      }
 
     if (currentSchema.version == currentSchema.schemaVersion)
       *this = currentSchema;
@@ -1075,6 +1622,7 @@ namespace
     set<Wires::value_type, LessWire> wireSet(wires.begin(), wires.end());
     wires.clear();
     wires.insert(wireSet.begin(), wireSet.end());
+    wiresChanged();
 
     m_edited=false;
     reset_needed=true;
@@ -1108,8 +1656,9 @@ namespace
     return r;
   }
 
-  void Minsky::Zoom(float xOrigin, float yOrigin, float factor)
+  void Minsky::Zoom(float xOrigin, float yOrigin, double factor)
   {
+    canvasInvalidated();
     for (Wires::iterator w=wires.begin(); w!=wires.end(); ++w)
       w->second.zoom(xOrigin, yOrigin, factor);
     for (Operations::iterator o=operations.begin(); o!=operations.end(); ++o)
@@ -1125,8 +1674,9 @@ namespace
     m_zoomFactor*=factor;
   }
 
-  void Minsky::setZoom(float factor)
+  void Minsky::setZoom(double factor)
   {
+    canvasInvalidated();
     for (Operations::iterator o=operations.begin(); o!=operations.end(); ++o)
       if (o->second->group==-1)
         o->second->setZoom(factor);
@@ -1381,8 +1931,14 @@ namespace
     OperationIcon(args[0], args[1]).draw();
   }
 
+  bool Minsky::onTclThread()
+  {
+    return pthread_equal(pthread_self(), tclThread);
+  }
+
   void Minsky::displayErrorItem(float x, float y)
   {
+    if (!onTclThread()) return;
     tclcmd() << "catch {indicateCanvasItemInError"<<x<<y<<"}\n";
     Tcl_ResetResult(interp());
   }
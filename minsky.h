@@ -34,6 +34,12 @@ using namespace classdesc;
 #include "godleyIcon.h"
 #include "operation.h"
 #include "evalOp.h"
+#include "evalTape.h"
+#include "sparseJacobian.h"
+#include "godleyIncidence.h"
+#include "ensemble.h"
+#include "sweep.h"
+#include "recorder.h"
 #include "wire.h"
 #include "portManager.h"
 #include "plotWidget.h"
@@ -42,6 +48,18 @@ using namespace classdesc;
 #include "variable.h"
 #include "equations.h"
 #include "inGroupTest.h"
+#include "sceneIndex.h"
+#include "changeJournal.h"
+
+/// GSL ODE steppers available for integrating the model
+struct OdeStepper
+{
+  enum Type {rkf45, rkck, rk8pd, // explicit Runge-Kutta
+             rk4imp, bsimp, msbdf, // implicit, using the jacobian
+             numSteppers};
+  /// return the symbolic name of \a type
+  static string typeName(int type);
+};
 
 namespace minsky
 {
@@ -60,6 +78,7 @@ namespace minsky
   };
 
   struct RKdata; // an internal structure for holding Runge-Kutta data
+  class CompiledModel; // native code version of the equations
 
   // a place to put working variables of the Minsky class that needn't
   // be serialised.
@@ -76,8 +95,46 @@ namespace minsky
     };
 
     EvalOpVector equations;
+    /// equations lowered for evaluation, rebuilt by constructEquations
+    EvalTape tape;
     vector<Integral> integrals;
+    /// Godley tables compiled for evaluation, rebuilt by constructEquations
+    GodleyIncidence godleyIncidence;
+    /// sparsity of the Jacobian, rebuilt by constructEquations
+    JacobianPattern jacobianPattern;
     shared_ptr<RKdata> ode;
+    /// loaded native code for the equations, if useCompiledModel set
+    shared_ptr<CompiledModel> compiledModel;
+    /// worker threads for evaluating the equations, if nThreads>1
+    shared_ptr<ThreadPool> threadPool;
+    /// variants of the model integrated together, set up by initEnsemble
+    Ensemble ensemble;
+    /// parameter sweep, run by runSweep
+    Sweep sweep;
+    /// time series recording, appended to after each step
+    Recorder recorder;
+    /// outlines of the canvas items, for lasso selection
+    SceneIndex sceneIndex;
+    /// canvas items changed since the canvas was last redrawn
+    ChangeJournal canvasJournal;
+
+    /// @{ report a change to a variable, operation or group, to both
+    /// the scene index and the canvas journal
+    void touched(const SceneIndex::Item& item);
+    void touched(const void* object)
+    {sceneIndex.touched(object); canvasJournal.touched(object);}
+    /// @}
+    /// report a change affecting every canvas item, such as zooming
+    void canvasInvalidated()
+    {sceneIndex.invalidate(); canvasJournal.invalidate();}
+
+    /// working storage for evalEquations and jacobian, kept between
+    /// calls so that integration steps do not touch the heap
+    struct Scratch
+    {
+      vector<double> flow, ds, df, dfLane, d;
+    };
+    Scratch scratch;
   };
 
   /// convenience class for accessing matrix elements from a data array
@@ -98,6 +155,8 @@ namespace minsky
   class GetterSetter: public T
   {
     std::map<K, T>& map;
+    /// index derived from map, if any, which set() invalidates
+    IndexState* index;
   public:
     K key; ///<last key gotten
     void get(TCL_args args) {
@@ -110,8 +169,10 @@ namespace minsky
     void set(TCL_args args) {
       if (args.count) args>>key;
       map[key]=*this;
+      if (index) index->invalidate();
     }
-    GetterSetter(std::map<K,T>& m): map(m) {}
+    GetterSetter(std::map<K,T>& m, IndexState* index=NULL): 
+      map(m), index(index) {}
     // asignment is do nothing, as reference member is created as part
     // of constructor
     void operator=(const GetterSetter&) {}
@@ -170,6 +231,9 @@ namespace minsky
         }
     }
     GetterSetterPtr(std::map<K,T>& m): map(m) {}
+    /// the object last gotten, if any
+    friend const typename T::element_type* gotten(const GetterSetterPtr& g)
+    {return g.val.get();}
     // asignment is do nothing, as reference member is created as part
     // of constructor
     void operator=(const GetterSetterPtr&) {}
@@ -195,7 +259,11 @@ namespace minsky
     /// NaN. Either a variable name, or and operator type.
     std::string diagnoseNonFinite() const;
 
-    float m_zoomFactor;
+    /// compute stock derivatives \a d from tangent direction \a lane
+    /// of scratch.df and scratch.ds, as computed by EvalTape::deriv
+    void stockTangent(double d[], size_t lane);
+
+    double m_zoomFactor;
     bool reset_needed; ///< if a new model, or loaded from disk
     bool m_edited;
   public:
@@ -264,6 +332,9 @@ namespace minsky
     /// return list of available asset classes
     void assetClasses() {enumVals<GodleyTable::AssetClass>();}
 
+    /// list of available ODE steppers
+    void availableSteppers() {enumVals<OdeStepper::Type>();}
+
     /// add an operation
     int AddOperation(const char* op);
     int addOperation(TCL_args args) {return AddOperation(args);}
@@ -369,7 +440,7 @@ namespace minsky
     InGroup groupTest;
     void initGroupList(TCL_args args) {
       groupTest.initGroupList(groupItems, (args.count? args: -1));}
-    float localZoomFactor(TCL_args args) const {
+    double localZoomFactor(TCL_args args) const {
       std::string item((char*)args);
       int id=-1;
       // plot ids aren't integers ATM
@@ -384,15 +455,19 @@ namespace minsky
         return groupItems.find(g)->second.localZoom();
     }
 
+    /// canvas items created, modified or deleted since the last
+    /// call, as a TCL list of {change kind id} triples
+    string canvasChanges() {return canvasJournal.drain(*this);}
+
     /// current state of zoom
-    float zoomFactor() const {return m_zoomFactor;}
+    double zoomFactor() const {return m_zoomFactor;}
     /// zoom by \a factor, scaling all widget's coordinates, using (\a
     /// xOrigin, \a yOrigin) as the origin of the zoom transformation
-    void Zoom(float xOrigin, float yOrigin,float factor);
+    void Zoom(float xOrigin, float yOrigin,double factor);
     void zoom(TCL_args args) {Zoom(args[0],args[1],args[2]);}
     /// set scaling factors in all widgets, without adjusting
     /// coordinates, for use in reloading the model
-    void setZoom(float);
+    void setZoom(double);
 
     /// evaluate the Godley table (update stock variables according to
     /// the current value of the internal variables
@@ -411,6 +486,11 @@ namespace minsky
     /// evaluate the equations (stockVars.size() of them)
     void evalEquations(double result[], const double vars[]);
 
+    /// update flow variables \a fv from stock variables \a sv by
+    /// running the equation tape
+    /// @throws ecolab::error describing the first invalid operation
+    void evalFlowVars(double fv[], const double sv[]);
+
     /// returns number of equations
     size_t numEquations() const {return equations.size();}
 
@@ -421,6 +501,12 @@ namespace minsky
 
     typedef MinskyMatrix Matrix; 
     void jacobian(Matrix& jac, const double vars[]);
+    /// Jacobian restricted to jacobianPattern, evaluated with one
+    /// tangent direction per column colour
+    void sparseJacobian(SparseMatrix& jac, const double vars[]);
+    /// partial derivative of the stock derivatives with respect to
+    /// time, which arises from time operations
+    void timeDerivative(double dfdt[], const double vars[]);
 
     // Runge-Kutta parameters
     double stepMin; ///< minimum step size
@@ -428,18 +514,58 @@ namespace minsky
     int nSteps;     ///< number of steps per GUI update
     double epsAbs;     ///< absolute error
     double epsRel;     ///< relative error
+    OdeStepper::Type stepper; ///< integration method
+    /// generate and compile native code for the equations on reset,
+    /// instead of interpreting them
+    bool useCompiledModel;
+    /// number of threads used to evaluate the equations. Takes effect
+    /// on reset
+    int nThreads;
+    /// minimum number of independent operations worth distributing
+    /// across threads
+    int parallelThreshold;
 
     double t; ///< time
     void reset(); ///<resets the variables back to their initial values
     void step();  ///< step the equations (by n steps, default 1)
 
+    /// set up ensemble with \a nLanes variants of the current model,
+    /// each starting from the model's current time and state
+    void initEnsemble(int nLanes);
+    /// set the value of constant operation \a id in \a lane of ensemble
+    void setEnsembleParameter(int id, int lane, double value);
+    /// value of variable \a name in \a lane of ensemble
+    double ensembleValue(const string& name, int lane) const;
+
+    /// run the parameter sweep described by sweep over copies of this
+    /// model
+    void runSweep() {sweep.run(*this);}
+
+    /// record t and recorder.names (or all named variables) after
+    /// each step into \a filename
+    void startRecording(const char* filename)
+    {recorder.open(filename, variables);}
+    void stopRecording() {recorder.close();}
+
     /// save to a file
     void Save(const char* filename);
     void save(TCL_args args) {Save(args);}
-    /// load from a file
+    /// save in the compact binary format
+    void SaveBinary(const char* filename);
+    void saveBinary(TCL_args args) {SaveBinary(args);}
+    /// whether \a filename is in the binary format
+    static bool isBinaryModel(const char* filename);
+    /// load from a file, in either XML or binary format
     void Load(const char* filename);
     void load(TCL_args args) {Load(args);}
 
+    /// save the simulation state (variable values, time, step size
+    /// and plot data) of this model in binary form
+    void checkpoint(const char* filename);
+    /// resume the simulation from a checkpoint of this model
+    /// @throws ecolab::error if the checkpoint does not match the model
+    void restore(const char* filename);
+
     void ExportSchema(const char* filename, int schemaLevel=1);
     void exportSchema(TCL_args args) {
       const char* filename=args;
@@ -462,8 +588,12 @@ namespace minsky
       MathDAG::SystemOfEquations(*this).matlab(f);
     }
 
-    /// indicate position of error on canvas
+    /// indicate position of error on canvas. Does nothing off the
+    /// Tcl thread
     static void displayErrorItem(float x, float y);
+    /// true if called on the thread owning the Tcl interpreter. Models
+    /// run on other threads, eg sweep runs, must not report to Tcl
+    static bool onTclThread();
 
     /// returns operation ID for a given EvalOp. -1 if a temporary
     int opIdOfEvalOp(const EvalOpBase&) const;
@@ -476,11 +606,18 @@ namespace minsky
     string ecolabVersion() {return VERSION;}
   };
   
-  /// global minsky object
+  /// minsky object of the calling thread, or the global one if none
+  /// has been set
   Minsky& minsky();
-  /// RAII set the minsky object to a different one for the current scope.
-  struct LocalMinsky
+  /// RAII set the minsky object of the calling thread to a different
+  /// one for the current scope. Models may be run concurrently on
+  /// separate threads, each within its own LocalMinsky.
+  class LocalMinsky
   {
+    Minsky* prev;
+    LocalMinsky(const LocalMinsky&);
+    void operator=(const LocalMinsky&);
+  public:
     LocalMinsky(Minsky& m);
     ~LocalMinsky();
   };
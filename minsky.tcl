@@ -151,6 +151,7 @@ menu .menubar.file.menu
 
 button .menubar.rkData -text "Runge Kutta" -relief flat -command {
     foreach {var text} $rkVars { set rkVarInput($var) [$var] }
+    set rkVarInput(stepper) [stepper]
     deiconify .rkDataForm
     update idletasks
     ::tk::TabToWindow $rkVarInput(initial_focus)
@@ -317,7 +318,7 @@ proc reset {} {
 
     global oplist lastOp
     set oplist [opOrder]
-    updateCanvas
+    refreshCanvas
     updateGodleysDisplay
     set lastOp -1
 }
@@ -441,6 +442,16 @@ foreach {var text} $rkVars {
     grid [entry  .rkDataForm.text$row -width 20 -textvariable rkVarInput($var)] -column 20 -row $row -sticky ew
     incr row 10
 }
+
+grid [label .rkDataForm.label$row -text "Stepper"] -column 10 -row $row -sticky e
+set steppers {}
+foreach s [availableSteppers] {
+    if {$s=="numSteppers"} break
+    lappend steppers $s
+}
+grid [eval tk_optionMenu .rkDataForm.stepper rkVarInput(stepper) $steppers] -column 20 -row $row -sticky ew
+tooltip .rkDataForm.stepper "rkf45, rkck and rk8pd are explicit Runge-Kutta methods.\nrk4imp, bsimp and msbdf are implicit, and suit stiff models"
+incr row 10
 set rkVarInput(initial_focus) ".rkDataForm.text$rowdict(Min Step Size)"
 frame .rkDataForm.buttonBar
 button .rkDataForm.buttonBar.ok -text OK -command {setRKparms; closeRKDataForm}
@@ -470,6 +481,7 @@ proc closeRKDataForm {} {
 proc setRKparms {} {
     global rkVars rkVarInput
     foreach {var text} $rkVars { $var $rkVarInput($var) }
+    stepper $rkVarInput(stepper)
 }
 
 toplevel .preferencesForm
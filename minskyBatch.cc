@@ -0,0 +1,172 @@
+/*
+  @copyright Steve Keen 2013
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+   @file headless driver for running a model without Tk. Loads a
+   model, steps it to a given time or step count, and streams the
+   selected variables after each step as CSV, or as binary doubles.
+
+   usage: minsky-batch [options] model.mky
+     -t endTime    run until t>=endTime
+     -n steps      run for this many calls of step() (default 100)
+     -o file       output file (default stdout)
+     -f csv|binary output format (default csv)
+     -v name       variable to output, may be repeated (default all
+                   named variables)
+
+   Binary output consists of a single header line of column names
+   separated by spaces, followed by rows of native doubles, one row
+   per step.
+
+   Tk is never initialised, so no display is needed. A Tcl interpreter
+   does exist, as minsky.o's static initialisers register the minsky
+   object's commands with it on startup, but no script is evaluated.
+*/
+
+#include "minsky.h"
+#include <ecolab_epilogue.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <string>
+
+using namespace std;
+using namespace minsky;
+
+namespace
+{
+  void usage(const char* prog)
+  {
+    fprintf(stderr, "usage: %s [-t endTime] [-n steps] [-o file] "
+            "[-f csv|binary] [-v name]... model.mky\n", prog);
+    exit(1);
+  }
+
+  /// writes rows of values in the requested format
+  class Output
+  {
+    FILE* f;
+    bool binary;
+    vector<char> buffer;
+  public:
+    Output(const char* file, bool binary): binary(binary), buffer(1<<20)
+    {
+      f=file? fopen(file, binary? "wb": "w"): stdout;
+      if (!f) throw error("cannot open %s", file);
+      setvbuf(f, &buffer[0], _IOFBF, buffer.size());
+    }
+    ~Output() {if (f!=stdout) fclose(f); else fflush(f);}
+
+    void header(const vector<string>& columns)
+    {
+      for (size_t i=0; i<columns.size(); ++i)
+        fprintf(f, "%s%s", i? (binary? " ": ","): "", columns[i].c_str());
+      fputc('\n', f);
+    }
+
+    void row(const vector<double>& values)
+    {
+      if (binary)
+        fwrite(&values[0], sizeof(double), values.size(), f);
+      else
+        {
+          for (size_t i=0; i<values.size(); ++i)
+            fprintf(f, i? ",%.17g": "%.17g", values[i]);
+          fputc('\n', f);
+        }
+      if (ferror(f)) throw error("error writing output");
+    }
+  };
+}
+
+int main(int argc, char* argv[])
+{
+  double endTime=-1;
+  long nSteps=100;
+  const char* outFile=NULL;
+  bool binary=false;
+  vector<string> names;
+
+  int i=1;
+  for (; i<argc && argv[i][0]=='-'; ++i)
+    {
+      if (i+1>=argc || argv[i][2]) usage(argv[0]);
+      switch (argv[i][1])
+        {
+        case 't': endTime=atof(argv[++i]); break;
+        case 'n': nSteps=atol(argv[++i]); break;
+        case 'o': outFile=argv[++i]; break;
+        case 'f':
+          ++i;
+          if (strcmp(argv[i],"binary")==0) binary=true;
+          else if (strcmp(argv[i],"csv")!=0) usage(argv[0]);
+          break;
+        case 'v': names.push_back(argv[++i]); break;
+        default: usage(argv[0]);
+        }
+    }
+  if (i!=argc-1) usage(argv[0]);
+
+  try
+    {
+      Minsky m;
+      LocalMinsky lm(m);
+      m.Load(argv[i]);
+      // variables are allocated their slots by reset, which step()
+      // would otherwise repeat
+      m.reset();
+      m.resetNotNeeded();
+
+      if (names.empty())
+        for (VariableManager::VariableValues::const_iterator v=
+               m.variables.values.begin(); v!=m.variables.values.end(); ++v)
+          if (!v->second.temp() && v->second.idx()>=0)
+            names.push_back(v->first);
+
+      vector<const VariableValue*> vars;
+      vector<string> columns(1, "t");
+      for (size_t j=0; j<names.size(); ++j)
+        {
+          if (m.variables.values.count(names[j])==0)
+            throw error("unknown variable %s", names[j].c_str());
+          vars.push_back(&m.variables.values[names[j]]);
+          columns.push_back(names[j]);
+        }
+
+      Output out(outFile, binary);
+      out.header(columns);
+      vector<double> row(columns.size());
+      for (long step=0; endTime>=0? m.t<endTime: step<nSteps; ++step)
+        {
+          m.step();
+          row[0]=m.t;
+          for (size_t j=0; j<vars.size(); ++j)
+            row[j+1]=vars[j]->value();
+          out.row(row);
+        }
+    }
+  catch (std::exception& e)
+    {
+      fprintf(stderr, "%s\n", e.what());
+      return 1;
+    }
+  return 0;
+}
@@ -0,0 +1,75 @@
+/*
+  @copyright Steve Keen 2013
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+   @file converts model files between the XML and binary formats.
+
+   usage: minsky-convert [-b|-x] input output
+     -b  write the binary format
+     -x  write the XML format
+
+   Without an option, the output is written in the opposite format of
+   the input.
+*/
+
+#include "minsky.h"
+#include <ecolab_epilogue.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace minsky;
+
+namespace
+{
+  void usage(const char* prog)
+  {
+    fprintf(stderr, "usage: %s [-b|-x] input output\n", prog);
+    exit(1);
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  enum {toggle, binary, xml} format=toggle;
+  int i=1;
+  if (i<argc && strcmp(argv[i],"-b")==0) {format=binary; ++i;}
+  else if (i<argc && strcmp(argv[i],"-x")==0) {format=xml; ++i;}
+  if (i!=argc-2) usage(argv[0]);
+
+  try
+    {
+      Minsky m;
+      LocalMinsky lm(m);
+      if (format==toggle)
+        format=Minsky::isBinaryModel(argv[i])? xml: binary;
+      m.Load(argv[i]);
+      if (format==binary)
+        m.SaveBinary(argv[i+1]);
+      else
+        m.Save(argv[i+1]);
+    }
+  catch (std::exception& e)
+    {
+      fprintf(stderr, "%s\n", e.what());
+      return 1;
+    }
+  return 0;
+}
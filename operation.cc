@@ -70,6 +70,7 @@ namespace minsky
   void OperationBase::move(float x1, float y1)
   {
     m_x+=x1; m_y+=y1;
+    minsky().touched(this);
     for (size_t i=0; i<m_ports.size(); ++i)
       portManager().movePort(m_ports[i], x1, y1);
   }
@@ -132,6 +133,7 @@ namespace minsky
   {
     Super::operator=(x); 
     intVar=-1;  // cause a new integral variable to be created
+    variableManager().integralsChanged();
     m_description=x.m_description; 
     addPorts();
   }
@@ -158,8 +160,10 @@ namespace minsky
     if (numPorts()>0)
       {
         // save any attached wires for later use
-        array<int> outWires=portManager().WiresAttachedToPort(m_ports[0]);
-        for (array<int>::iterator i=outWires.begin(); i!=outWires.end(); ++i)
+        const PortManager::WireIds& outWires=
+          portManager().WiresAttachedToPort(m_ports[0]);
+        for (PortManager::WireIds::const_iterator i=outWires.begin(); 
+             i!=outWires.end(); ++i)
           savedWires.push_back(portManager().wires[*i]);
       }
 
@@ -193,6 +197,7 @@ namespace minsky
     VariablePtr iv(VariableType::integral, m_description);
     iv->visible=false; // we're managing our own display
     intVar=variableManager().addVariable(iv);
+    variableManager().integralsChanged();
 
     // make the intVar outport the integral operator's outport
     if (m_ports.size()<1) m_ports.resize(1);
@@ -315,7 +320,7 @@ namespace minsky
     return coupled();
   }
 
-  void OperationBase::zoom(float xOrigin, float yOrigin,float factor)
+  void OperationBase::zoom(float xOrigin, float yOrigin,double factor)
   {
     if (visible)
       {
@@ -330,9 +335,16 @@ namespace minsky
             m_y*=factor;
           }
         zoomFactor*=factor;
+        minsky().touched(this);
       }
   }
 
+  void OperationBase::setZoom(double factor)
+  {
+    zoomFactor=factor;
+    minsky().touched(this);
+  }
+
   string OperationBase::portValues() const
   {
     string r="equations not yet constructed, please reset";
@@ -342,13 +354,13 @@ namespace minsky
       if (this==(*ei)->state.get())
         {
           const EvalOpBase& e=**ei;
-          r="[out]="+str(ValueVector::flowVars[e.out]);
+          r="[out]="+str(minsky().flowVars[e.out]);
           if (e.numArgs()>0)
-            r+=" [in1]="+ str(e.flow1? ValueVector::flowVars[e.in1]: 
-                               ValueVector::stockVars[e.in1]);
+            r+=" [in1]="+ str(e.flow1? minsky().flowVars[e.in1]: 
+                               minsky().stockVars[e.in1]);
           if (e.numArgs()>1)
-            r+=" [in2]="+ str(e.flow2? ValueVector::flowVars[e.in2]: 
-                               ValueVector::stockVars[e.in2]);
+            r+=" [in2]="+ str(e.flow2? minsky().flowVars[e.in2]: 
+                               minsky().stockVars[e.in2]);
         }
     return r;
   }
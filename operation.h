@@ -64,7 +64,8 @@ namespace minsky
     // triangle parameters - l: xcoord of lhs, r; xcoord of apex, h: height of base
     static const float l=-8, h=12, r=12;
 
-    float m_x, m_y, zoomFactor;
+    float m_x, m_y;
+    double zoomFactor;
     // operator dependent data
     double rotation; /// rotation if icon, in degrees
 
@@ -117,8 +118,8 @@ namespace minsky
 
     /// zoom by \a factor, scaling all widget's coordinates, using (\a
     /// xOrigin, \a yOrigin) as the origin of the zoom transformation
-    void zoom(float xOrigin, float yOrigin,float factor);
-    void setZoom(float factor) {zoomFactor=factor;}
+    void zoom(float xOrigin, float yOrigin,double factor);
+    void setZoom(double factor);
 
     /// returns true if from matches the out port, and to matches one of
     /// the in ports
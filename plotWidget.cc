@@ -21,6 +21,7 @@
 #include "init.h"
 #include "cairoItems.h"
 #include "minsky.h"
+#include <limits>
 #include <ecolab_epilogue.h>
 using namespace ecolab::cairo;
 using namespace ecolab;
@@ -42,6 +43,21 @@ namespace
   // y coordinates of bounding box ports
   const float boundY[]={0.49,0.49,0.47,-0.49};
 
+  /// place input port \a id of a plot at (x,y), via the PortManager
+  /// so that its spatial index remains current
+  void placePort(int id, float x, float y)
+  {
+    PortManager& pm=portManager();
+    PortManager::Ports::iterator p=pm.ports.find(id);
+    if (p==pm.ports.end())
+      {
+        pm.ports[id]=Port(x, y, true);
+        pm.portsChanged();
+      }
+    else if (p->second.x()!=x || p->second.y()!=y)
+      pm.movePortTo(id, x, y);
+  }
+
   /// temporarily sets nTicks and fontScale, restoring them on scope exit
   struct SetTicksAndFontSize
   {
@@ -149,7 +165,7 @@ namespace
         for (size_t i=0; i<4; ++i)
           {
             float x=boundX[i]*w, y=boundY[i]*h;
-            portManager().ports[pw.ports[i]]=Port(x + pw.x(), y + pw.y(), true);
+            placePort(pw.ports[i], x + pw.x(), y + pw.y());
             drawTriangle(cairo, x+0.5*w, y+0.5*h, palette[(i/2)%paletteSz], orient[i]);
          
           }
@@ -158,7 +174,7 @@ namespace
         for (size_t i=4; i<numLines+4; ++i)
           {
             float y=0.5*(dy-h) + (i-4)*dy;
-            portManager().ports[pw.ports[i]]=Port(x + pw.x(), y + pw.y(), true);
+            placePort(pw.ports[i], x + pw.x(), y + pw.y());
             drawTriangle(cairo, x+0.5*w, y+0.5*h, palette[(i-4)%paletteSz], 0);
           }
 
@@ -166,7 +182,7 @@ namespace
         for (size_t i=numLines+4; i<2*numLines+4; ++i)
           {
             float x=0.5*(dx-w) + (i-numLines-4)*dx;
-            portManager().ports[pw.ports[i]]=Port(x + pw.x(), y + pw.y(), true);
+            placePort(pw.ports[i], x + pw.x(), y + pw.y());
             drawTriangle(cairo, x+0.5*w, y+0.5*h, palette[(i-numLines-4)%paletteSz], -0.5*M_PI);
           }
 
@@ -219,14 +235,33 @@ void PlotWidget::MoveTo(float x1, float y1)
   float w=width(), h=height();
   float dx=x1-x(), dy=y1-y();
   m_x=x1; m_y=y1;
+  minsky().canvasJournal.touched(this);
   for (size_t i=0; i<ports.size(); ++i)
     portManager().movePort(ports[i], dx, dy);
 }
 
+void PlotWidget::zoom(float xOrigin, float yOrigin, double factor)
+{
+  minsky::zoom(m_x, xOrigin, factor);
+  minsky::zoom(m_y, yOrigin, factor);
+  zoomFactor*=factor;
+  minsky().canvasJournal.touched(this);
+}
+
 void PlotWidget::scalePlot()
 {
-  // set any scale overrides
   setMinMax();
+  // points hidden within the columns of the level of detail buffers
+  // were never handed to Plot, but still count towards its extent
+  for (size_t i=0; i<lod.size(); ++i)
+    if (!lod[i].empty())
+      {
+        minx=min(minx, lod[i].lower().x);
+        maxx=max(maxx, lod[i].upper().x);
+        miny=min(miny, lod[i].lower().y);
+        maxy=max(maxy, lod[i].upper().y);
+      }
+  // set any scale overrides
   if (xminVar.idx()>-1) {minx=xminVar.value();}
   if (xmaxVar.idx()>-1) {maxx=xmaxVar.value();}
   if (yminVar.idx()>-1) {miny=yminVar.value();}
@@ -252,9 +287,84 @@ void PlotWidget::redraw()
     }
 }
 
+void PlotWidget::replot()
+{
+  Plot::clear();
+  for (size_t pen=0; pen<lod.size(); ++pen)
+    {
+      lod[pen].points(pts);
+      for (size_t i=0; i<pts.size(); ++i)
+        add(pen, pts[i].x, pts[i].y);
+    }
+}
+
 void PlotWidget::addPlotPt(double t)
 {
+  bool modified=false;
+  appended.clear();
+  for (size_t pen=0; pen<yvars.size(); ++pen)
+    if (yvars[pen].idx()>=0)
+      {
+        double x, y=yvars[pen].value();
+        switch (xvars.size())
+          {
+          case 0: // use t, when x variable not attached
+            x=t;
+            break;
+          case 1: // use the value of attached variable
+            assert(xvars[0].idx()>=0);
+            x=xvars[0].value();
+            break;
+          default:
+            if (pen < xvars.size() && xvars[pen].idx()>=0)
+              x=xvars[pen].value();
+            else
+              throw error("x input not wired for pen %d",(int)pen+1);
+            break;
+          }
+        if (lod.size()<=pen) lod.resize(pen+1);
+        lod[pen].maxColumns=max(resolution, 1U);
+        switch (lod[pen].add(x,y))
+          {
+          case PlotLOD::unchanged:
+            break;
+          case PlotLOD::appended:
+            appended.push_back(PenPt(pen, PlotLOD::Pt(x,y)));
+            break;
+          case PlotLOD::modified:
+            modified=true;
+            break;
+          }
+      }
+
+  // the first surface, if any, has the appended segments drawn onto
+  // it as they are added, at the current scale
+  size_t first=0;
+  while (first<images.size() && !surfaces.count(images[first])) ++first;
+  map<string, shared_ptr<TkPhotoSurface> >::iterator firstSurf=
+    first<images.size()? surfaces.find(images[first]): surfaces.end();
+
+  double x0=minx, x1=maxx, y0=miny, y1=maxy;
+  if (modified)
+    replot(); // lod already contains the appended points
+  else if (firstSurf!=surfaces.end())
+    {
+      SetTicksAndFontSize stf
+        (*this, first==0, displayNTicks, displayFontSize, false);
+      for (size_t i=0; i<appended.size(); ++i)
+        add(*firstSurf->second, appended[i].pen, 
+            appended[i].p.x, appended[i].p.y);
+    }
+  else
+    for (size_t i=0; i<appended.size(); ++i)
+      add(appended[i].pen, appended[i].p.x, appended[i].p.y);
+
   scalePlot();
+  bool rescaled=x0!=minx || x1!=maxx || y0!=miny || y1!=maxy;
+  // if the point is hidden within already drawn columns, and the
+  // scale is unaltered, there is nothing to redraw
+  if (!modified && !rescaled && appended.empty())
+    return;
   
   for (size_t i=0; i<images.size(); ++i)
     {
@@ -262,43 +372,147 @@ void PlotWidget::addPlotPt(double t)
         surfaces.find(images[i]);
       if (surf!=surfaces.end())
         {
+          if (!modified && !rescaled && i==first)
+            {
+              // the new segments are already drawn
+              surf->second->blit();
+              continue;
+            }
           SetTicksAndFontSize stf
             (*this, i==0, displayNTicks, displayFontSize, false);
-          double x[yvars.size()], y[yvars.size()];
-          for (size_t pen=0; pen<yvars.size(); ++pen)
-            if (yvars[pen].idx()>=0)
-              {
-                switch (xvars.size())
-                  {
-                  case 0: // use t, when x variable not attached
-                    x[pen]=t;
-                    y[pen]=yvars[pen].value();
-                    break;
-                  case 1: // use the value of attached variable
-                    assert(xvars[0].idx()>=0);
-                    x[pen]=xvars[0].value();
-                    y[pen]=yvars[pen].value();
-                    break;
-                  default:
-                    if (pen < xvars.size() && xvars[pen].idx()>=0)
-                      {
-                        x[pen]=xvars[pen].value();
-                        y[pen]=yvars[pen].value();
-                      }
-                    else
-                      throw error("x input not wired for pen %d",(int)pen+1);
-                    break;
-                  }
-                add(*surf->second, pen, x[pen], y[pen]);
-              }
-                  
-          //TODO: I honestly do not know why these lines need to be here.
+          // redraw in full, which also resets grid drawing on canvas
+          // plots. The cost is bounded by resolution
           surf->second->clear();
-
-          // reset grid drawing on canvas plots
           draw(*surf->second);
           surf->second->blit();
-          
+        }
+    }
+}
+
+const size_t PlotLOD::defaultColumns;
+
+PlotLOD::Change PlotLOD::add(double x, double y)
+{
+  Pt p(x,y);
+  m_lower.x=min(m_lower.x, x); m_lower.y=min(m_lower.y, y);
+  m_upper.x=max(m_upper.x, x); m_upper.y=max(m_upper.y, y);
+  if (!decimating)
+    {
+      raw.push_back(p);
+      if (raw.size()<=2*maxColumns+1)
+        return appended;
+      while (raw.size()>2*maxColumns+1) thin();
+      return modified;
+    }
+  if (columns.empty())
+    {
+      // columns never number more than maxColumns
+      columns.reserve(maxColumns);
+      x0=x;
+      columns.push_back(Column(0,p));
+      return appended;
+    }
+
+  // keep the points in order once x goes backwards
+  Column& last=columns.back();
+  if (x<max(last.lo.x, last.hi.x))
+    {
+      raw.reserve(2*maxColumns+2);
+      points(raw);
+      raw.push_back(p);
+      columns.clear();
+      decimating=false;
+      return appended;
+    }
+
+  if (dx==0 && x>x0) dx=x-x0; // first step sets the initial resolution
+  size_t col=dx>0? size_t((x-x0)/dx): 0;
+  bool merged=false;
+  while (col>=maxColumns)
+    {
+      mergeColumns();
+      col=size_t((x-x0)/dx);
+      merged=true;
+    }
+
+  Column& c=columns.back();
+  if (col>c.idx)
+    {
+      columns.push_back(Column(col,p));
+      return merged? modified: appended;
+    }
+
+  // extend the last column's range
+  Pt first=c.lo;
+  bool single=c.lo==c.hi;
+  if (y<c.lo.y)
+    c.lo=p;
+  else if (y>c.hi.y)
+    c.hi=p;
+  else
+    return merged? modified: unchanged;
+  // a second point in a column is drawn after the first
+  return single && !merged && x>first.x? appended: modified;
+}
+
+void PlotLOD::mergeColumns()
+{
+  dx*=2;
+  size_t j=0;
+  for (size_t i=0; i<columns.size(); ++i)
+    {
+      Column& c=columns[i];
+      c.idx/=2;
+      if (j>0 && columns[j-1].idx==c.idx)
+        {
+          Column& m=columns[j-1];
+          if (c.lo.y<m.lo.y) m.lo=c.lo;
+          if (c.hi.y>m.hi.y) m.hi=c.hi;
+        }
+      else
+        columns[j++]=c;
+    }
+  columns.resize(j);
+}
+
+void PlotLOD::thin()
+{
+  size_t j=0;
+  for (size_t i=0; i<raw.size(); i+=2)
+    raw[j++]=raw[i];
+  if (raw.size()%2==0)
+    raw[j++]=raw.back();
+  raw.resize(j);
+}
+
+void PlotLOD::clearExtent()
+{
+  m_lower=Pt(numeric_limits<double>::max(), numeric_limits<double>::max());
+  m_upper=Pt(-numeric_limits<double>::max(), -numeric_limits<double>::max());
+}
+
+void PlotLOD::points(vector<Pt>& pts) const
+{
+  if (!decimating)
+    {
+      pts=raw;
+      return;
+    }
+  pts.clear();
+  for (size_t i=0; i<columns.size(); ++i)
+    {
+      const Column& c=columns[i];
+      if (c.lo==c.hi)
+        pts.push_back(c.lo);
+      else if (c.lo.x<=c.hi.x)
+        {
+          pts.push_back(c.lo);
+          pts.push_back(c.hi);
+        }
+      else
+        {
+          pts.push_back(c.hi);
+          pts.push_back(c.lo);
         }
     }
 }
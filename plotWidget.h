@@ -31,10 +31,92 @@
 
 namespace minsky
 {
+  /**
+     Level of detail buffer for one pen of a plot. Points are binned
+     into columns of equal width in x, each keeping only its lowest
+     and highest points, so the number of points drawn is bounded by
+     the number of columns, rather than by the length of the run. When
+     a point lands beyond the last column, the column width is doubled
+     by merging pairs of columns. A point going backwards in x (eg a
+     phase plot) switches the pen to keeping the points in order,
+     dropping every second point whenever there are more than twice
+     maxColumns of them.
+  */
+  class PlotLOD
+  {
+  public:
+    struct Pt
+    {
+      double x, y;
+      Pt(double x=0, double y=0): x(x), y(y) {}
+      bool operator==(const Pt& p) const {return x==p.x && y==p.y;}
+    };
+    /// at least one column per horizontal pixel of a plot
+    static const size_t defaultColumns=1024;
+    /// bound on the number of columns, which must be at least 1. The
+    /// points to be drawn number at most twice this, plus one
+    size_t maxColumns;
+
+    /// effect of adding a point on the points to be drawn
+    enum Change {unchanged, ///< point lies within its column's range
+                 appended, ///< the point is appended to the points
+                 modified ///< the points have otherwise changed
+    };
+
+    PlotLOD(): maxColumns(defaultColumns), x0(0), dx(0), decimating(true)
+    {clearExtent();}
+    /// add point (x,y)
+    Change add(double x, double y);
+    /// the points to be drawn, in order of x
+    void points(std::vector<Pt>&) const;
+    void clear() 
+    {columns.clear(); raw.clear(); dx=0; decimating=true; clearExtent();}
+
+    /// @{ bounding box of all points added, including those not drawn
+    const Pt& lower() const {return m_lower;}
+    const Pt& upper() const {return m_upper;}
+    bool empty() const {return m_lower.x>m_upper.x;}
+    /// @}
+
+  private:
+    CLASSDESC_ACCESS(PlotLOD);
+    struct Column
+    {
+      size_t idx; ///< column number, x in [x0+idx*dx, x0+(idx+1)*dx)
+      Pt lo, hi; ///< lowest and highest points in the column
+      Column(size_t idx=0, const Pt& p=Pt()): idx(idx), lo(p), hi(p) {}
+    };
+    double x0, dx; ///< origin and width of columns
+    std::vector<Column> columns;
+    bool decimating;
+    std::vector<Pt> raw; ///< points, in order, once decimating is false
+    Pt m_lower, m_upper;
+    void mergeColumns();
+    /// drop every second point of raw, keeping the last
+    void thin();
+    void clearExtent();
+  };
+
   // a container item for a plot widget
   class PlotWidget: public ecolab::Plot
   {
     float m_x, m_y;
+    /// decimated data of each pen, which is what is handed to Plot
+    std::vector<PlotLOD> lod;
+    /// a point appended to the drawn points of a pen
+    struct PenPt
+    {
+      size_t pen;
+      PlotLOD::Pt p;
+      PenPt(size_t pen=0, const PlotLOD::Pt& p=PlotLOD::Pt()): pen(pen), p(p) {}
+    };
+    /// @{ scratch buffers, reused so that adding a point does not
+    /// touch the heap
+    std::vector<PenPt> appended;
+    std::vector<PlotLOD::Pt> pts;
+    /// @}
+    /// replace the plotted data with the contents of lod
+    void replot();
     CLASSDESC_ACCESS(PlotWidget);
     friend class SchemaHelper;
   public:
@@ -47,6 +129,8 @@ namespace minsky
 
     /// variable ports specifying plot size
     VariableValue xminVar, xmaxVar, yminVar, ymaxVar;
+    /// maximum number of columns each pen's data is binned into
+    unsigned resolution;
     /// number of ticks to show in canvas item
     unsigned displayNTicks;
     double displayFontSize;
@@ -59,6 +143,7 @@ namespace minsky
     /// @}
 
     PlotWidget(): m_x(0), m_y(0), zoomFactor(1), 
+                  resolution(PlotLOD::defaultColumns),
                   displayNTicks(3), displayFontSize(3) {grid=true;}
 
     void MoveTo(float x, float y);
@@ -67,19 +152,24 @@ namespace minsky
     /// connect variable \a var to port \a port. 
     void connectVar(const VariableValue& var, unsigned port);
     void redraw(); // redraw plot using current data
+    /// clear the plotted data. As ecolab::Plot::clear is not virtual,
+    /// clear a plot through its PlotWidget, so the level of detail
+    /// buffers are cleared along with it
+    void clear() {Plot::clear(); lod.clear();}
+    /// level of detail buffers of the pens, which checkpoints save
+    /// along with the plotted data
+    friend std::vector<PlotLOD>& plotLOD(PlotWidget& p) {return p.lod;}
 
     /// set autoscaling
     void autoScale() {xminVar=xmaxVar=yminVar=ymaxVar=VariableValue();}
+    /// set the plot's bounds, from the extent of all points added
+    /// unless overridden by the bounds ports
     void scalePlot();
 
     /// adjust coordinates and zoomFactor, where (\a xOrigin, \a
     /// yOrigin) is the origin of the zooming
-    void zoom(float xOrigin, float yOrigin, float factor) {
-      minsky::zoom(m_x, xOrigin, factor);
-      minsky::zoom(m_y, yOrigin, factor);
-      zoomFactor*=factor;
-    }
-    float zoomFactor;
+    void zoom(float xOrigin, float yOrigin, double factor);
+    double zoomFactor;
   };
 
   /// global register of plot widgets, indexed by the item image name
@@ -175,6 +175,6 @@ proc plotDoubleClick {image} {
 proc deletePlot {item image} {
     .wiring.canvas delete $item
     minsky.deletePlot $image
-    updateCanvas
+    refreshCanvas
 }
     
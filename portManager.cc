@@ -18,14 +18,87 @@
 */
 #include "portManager.h"
 #include "minsky.h"
+#include "geometry.h"
+#include "str.h"
 #include <tcl++.h>
 #include <ecolab_epilogue.h>
 
+#include <boost/geometry/geometry.hpp>
+#include <boost/geometry/index/rtree.hpp>
+#include <algorithm>
+
 using namespace std;
 using namespace minsky;
 
 PortManager& minsky::portManager() {return minsky::minsky();}
 
+namespace minsky
+{
+  namespace bgi=boost::geometry::index;
+
+  /// ports indexed by location, with input and output ports kept
+  /// separately, as wiring queries one or the other
+  struct PortIndex
+  {
+    typedef pair<Point,int> Entry;
+    typedef bgi::rtree<Entry, bgi::quadratic<16> > Tree;
+    Tree inputs, outputs;
+
+    static Entry entry(int id, const Port& p) 
+    {return Entry(Point(p.x(),p.y()), id);}
+    Tree& tree(const Port& p) {return p.input? inputs: outputs;}
+
+    PortIndex(const PortManager::Ports& ports)
+    {
+      vector<Entry> in, out;
+      for (PortManager::Ports::const_iterator p=ports.begin(); 
+           p!=ports.end(); ++p)
+        (p->second.input? in: out).push_back(entry(p->first, p->second));
+      // bulk loading produces a better tree than repeated insertion
+      Tree(in.begin(), in.end()).swap(inputs);
+      Tree(out.begin(), out.end()).swap(outputs);
+    }
+
+    void insert(int id, const Port& p) {tree(p).insert(entry(id, p));}
+    void remove(int id, const Port& p) {tree(p).remove(entry(id, p));}
+
+    /// closest port to (x,y) in \a t, with its squared distance, or
+    /// -1 if \a t is empty
+    static int closest(const Tree& t, float x, float y, float& r)
+    {
+      vector<Entry> result;
+      t.query(bgi::nearest(Point(x,y), 1), back_inserter(result));
+      if (result.empty()) return -1;
+      const Point& p=result[0].first;
+      r=(x-p.x())*(x-p.x()) + (y-p.y())*(y-p.y());
+      return result[0].second;
+    }
+  };
+}
+
+PortIndex& PortManager::spatialIndex()
+{
+  if (!portIndex || !portsIndexed.current(ports.size()))
+    {
+      portIndex.reset(new PortIndex(ports));
+      portsIndexed.update(ports.size());
+    }
+  return *portIndex;
+}
+
+int PortManager::addPort(const Port& p) 
+{
+  int nextId=ports.empty()? 0: ports.rbegin()->first+1;
+  bool indexCurrent=portIndex && portsIndexed.current(ports.size());
+  ports.insert(Ports::value_type(nextId, p));
+  if (indexCurrent)
+    {
+      portIndex->insert(nextId, p);
+      portsIndexed.update(ports.size());
+    }
+  return nextId;
+}
+
 int PortManager::addWire(Wire w) 
 {
   // adjust end points to be aligned with ports
@@ -41,7 +114,16 @@ int PortManager::addWire(Wire w)
   w.Coords(coords);
 
   int nextId=wires.empty()? 0: wires.rbegin()->first+1;
+  bool indexCurrent=wiresIndexed.current(wires.size());
   wires.insert(Wires::value_type(nextId, w));
+  if (indexCurrent)
+    {
+      // nextId is the largest, so lists remain in ascending order
+      portWires[w.from].push_back(nextId);
+      if (w.to!=w.from) portWires[w.to].push_back(nextId);
+      wiresIndexed.update(wires.size());
+    }
+  minsky().canvasJournal.touched(ChangeJournal::wire, str(nextId));
   
   assert(minsky().variables.noMultipleWiredInputs());
   return nextId;
@@ -50,12 +132,16 @@ int PortManager::addWire(Wire w)
 
 void PortManager::movePortTo(int port, float x, float y)
 {
-  if (ports.count(port))
+  Ports::iterator pi=ports.find(port);
+  if (pi!=ports.end())
     {
-      Port& p=ports[port];
+      Port& p=pi->second;
+      bool indexCurrent=portIndex && portsIndexed.current(ports.size());
+      if (indexCurrent) portIndex->remove(port, p);
       p.m_x=x; p.m_y=y;
-      array<int> attachedWires=WiresAttachedToPort(port);
-      for (array<int>::iterator i=attachedWires.begin(); 
+      if (indexCurrent) portIndex->insert(port, p);
+      const WireIds& attachedWires=WiresAttachedToPort(port);
+      for (WireIds::const_iterator i=attachedWires.begin(); 
            i!=attachedWires.end(); ++i)
         {
           assert(wires.count(*i));
@@ -77,68 +163,107 @@ void PortManager::movePortTo(int port, float x, float y)
     }
 }
 
-template <class C>
-int PortManager::closestPortImpl(float x, float y)
+int PortManager::ClosestPort(float x, float y)
+{
+  PortIndex& index=spatialIndex();
+  float rIn=0, rOut=0;
+  int in=PortIndex::closest(index.inputs, x, y, rIn);
+  int out=PortIndex::closest(index.outputs, x, y, rOut);
+  if (in<0) return out;
+  if (out<0) return in;
+  return rIn<rOut? in: out;
+}
+
+int PortManager::ClosestOutPort(float x, float y)
+{
+  float r;
+  return PortIndex::closest(spatialIndex().outputs, x, y, r);
+}
+
+int PortManager::ClosestInPort(float x, float y)
 {
-  int port=-1;
-  float minr=numeric_limits<float>::max();
-  for (Ports::const_iterator i=ports.begin(); i!=ports.end(); ++i)
-    if (C::eval(i->second))
+  float r;
+  return PortIndex::closest(spatialIndex().inputs, x, y, r);
+}
+
+const map<int, PortManager::WireIds>& PortManager::wireIndex() const
+{
+  if (!wiresIndexed.current(wires.size()))
     {
-      const Port& p=i->second;
-      float r=(x-p.x())*(x-p.x()) + (y-p.y())*(y-p.y());
-      if (r<minr)
+      portWires.clear();
+      for (Wires::const_iterator w=wires.begin(); w!=wires.end(); ++w)
         {
-          minr=r;
-          port=i->first;
+          portWires[w->second.from].push_back(w->first);
+          if (w->second.to!=w->second.from)
+            portWires[w->second.to].push_back(w->first);
         }
+      wiresIndexed.update(wires.size());
     }
-  return port;
+  return portWires;
 }
 
-namespace
+const PortManager::WireIds& PortManager::WiresAttachedToPort(int port) const
 {
-  struct AlwaysTrue
-  {
-    inline static bool eval(const Port& p) {return true;}
-  };
-  struct InputTrue
-  {
-    inline static bool eval(const Port& p) {return p.input;}
-  };
-  struct OutputTrue
-  {
-    inline static bool eval(const Port& p) {return !p.input;}
-  };
+  static const WireIds none;
+  map<int, WireIds>::const_iterator i=wireIndex().find(port);
+  return i==portWires.end()? none: i->second;
 }
 
+array<int> PortManager::wiresAttachedToPort(TCL_args args) const
+{
+  const WireIds& w=WiresAttachedToPort(args);
+  array<int> ret(w.size());
+  for (size_t i=0; i<w.size(); ++i)
+    ret[i]=w[i];
+  return ret;
+}
 
-int PortManager::ClosestPort(float x, float y)
-{return closestPortImpl<AlwaysTrue>(x,y);}
-
-int PortManager::ClosestOutPort(float x, float y)
-{return closestPortImpl<OutputTrue>(x,y);}
-
-int PortManager::ClosestInPort(float x, float y)
-{return closestPortImpl<InputTrue>(x,y);}
+namespace
+{
+  void removeFromIndex(map<int, PortManager::WireIds>& index, int port, int id)
+  {
+    map<int, PortManager::WireIds>::iterator i=index.find(port);
+    if (i==index.end()) return;
+    PortManager::WireIds& w=i->second;
+    w.erase(remove(w.begin(), w.end(), id), w.end());
+    if (w.empty()) index.erase(i);
+  }
+}
 
-array<int> PortManager::WiresAttachedToPort(int port) const
+void PortManager::deleteWire(int id)
 {
-  array<int> ret;
-  for (Wires::const_iterator w=wires.begin(); w!=wires.end(); ++w)
-    if (w->second.to == port || w->second.from == port)
-      ret <<= w->first;
-  return ret;
+  Wires::iterator w=wires.find(id);
+  if (w==wires.end()) return;
+  bool indexCurrent=wiresIndexed.current(wires.size());
+  if (indexCurrent)
+    {
+      removeFromIndex(portWires, w->second.from, id);
+      removeFromIndex(portWires, w->second.to, id);
+    }
+  wires.erase(w);
+  if (indexCurrent)
+    wiresIndexed.update(wires.size());
+  minsky().canvasJournal.touched(ChangeJournal::wire, str(id));
 }
 
 void PortManager::delPort(int port)
 {
   if (port>=0)
     {
-      array<int> wires=WiresAttachedToPort(port);
+      // copied, as deleteWire modifies the index
+      WireIds wires=WiresAttachedToPort(port);
       for (size_t i=0; i<wires.size(); ++i)
         deleteWire(wires[i]);
-      ports.erase(port);
+      Ports::iterator p=ports.find(port);
+      if (p!=ports.end())
+        {
+          bool indexCurrent=portIndex && portsIndexed.current(ports.size());
+          if (indexCurrent)
+            portIndex->remove(port, p->second);
+          ports.erase(p);
+          if (indexCurrent)
+            portsIndexed.update(ports.size());
+        }
     }
 }
 
@@ -20,29 +20,46 @@
 #define PORTMANAGER_H
 #include "port.h"
 #include "wire.h"
+#include "indexState.h"
 #include <vector>
 #include <map>
 
 #include <TCL_obj_base.h>
+#include <pack_base.h>
+#include <xml_pack_base.h>
+#include <xml_unpack_base.h>
 #include <assert.h>
 
 namespace minsky
 {
-  class PortManager
+  struct PortIndex; // spatial index of ports, defined in portManager.cc
+
+  // working data of PortManager that needn't be serialised
+  struct PortManagerExclude
+  {
+    /// built on demand by the closest port queries. Not copied, as
+    /// it refers to the ports of a particular PortManager
+    classdesc::shared_ptr<PortIndex> portIndex;
+    PortManagerExclude() {}
+    PortManagerExclude(const PortManagerExclude&) {}
+    PortManagerExclude& operator=(const PortManagerExclude&) 
+    {portIndex.reset(); return *this;}
+  };
+
+  class PortManager: public PortManagerExclude
   {
+    CLASSDESC_ACCESS(PortManager);
   public:
 
     typedef std::map<int, Port> Ports;
     typedef std::map<int, Wire> Wires;
+    /// ids of the wires attached to a port, in ascending order
+    typedef std::vector<int> WireIds;
     Ports ports;
     Wires wires;
 
     // add a port to the port map
-    int addPort(const Port& p) {
-      int nextId=ports.empty()? 0: ports.rbegin()->first+1;
-      ports.insert(Ports::value_type(nextId, p));
-      return nextId;
-    }
+    int addPort(const Port& p);
 
     int addWire(Wire w); 
   
@@ -68,19 +85,37 @@ namespace minsky
     int closestInPort(ecolab::TCL_args args) 
     {return ClosestInPort(args[0], args[1]);}
 
-    void deleteWire(int id) {wires.erase(id);}
-    ecolab::array<int> WiresAttachedToPort(int) const;
+    void deleteWire(int id);
+    /// wires attached to a port. The returned list is invalidated by
+    /// any change to the wires, so copy it if wires are to be
+    /// modified while traversing it.
+    const WireIds& WiresAttachedToPort(int) const;
 
     /// return a list of wires attached to a \a port
-    ecolab::array<int> wiresAttachedToPort(ecolab::TCL_args args) const
-    {return WiresAttachedToPort(args);}
+    ecolab::array<int> wiresAttachedToPort(ecolab::TCL_args args) const;
+
+    /// must be called after modifying wires directly, rather than
+    /// via addWire and deleteWire
+    void wiresChanged() {wiresIndexed.invalidate();}
+    /// must be called after modifying ports directly, rather than
+    /// via addPort, delPort and movePortTo
+    void portsChanged() {portsIndexed.invalidate();}
 
     ecolab::array<int> visibleWires() const;
 
+  protected:
+    /// whether portWires and portIndex reflect wires and ports
+    mutable IndexState wiresIndexed;
+    IndexState portsIndexed;
+
   private:
-    // the common closestPort implementation code
-    template <class C> int closestPortImpl(float, float);
+    /// wires attached to each port, maintained by addWire, deleteWire
+    /// and delPort, and rebuilt after wiresChanged()
+    mutable std::map<int, WireIds> portWires;
+    const std::map<int, WireIds>& wireIndex() const;
 
+    /// the spatial index of ports, rebuilt after portsChanged()
+    PortIndex& spatialIndex();
   };
 
 
@@ -90,5 +125,18 @@ namespace minsky
   void setPortManager(PortManager&);
 }
 
+inline void pack(pack_t&, const std::string&,minsky::PortManagerExclude&) {}
+inline void unpack(pack_t&, const std::string&,minsky::PortManagerExclude&) {}
+inline void xml_pack(xml_pack_t&, const std::string&,minsky::PortManagerExclude&) {}
+inline void xml_unpack(xml_unpack_t&, const std::string&,minsky::PortManagerExclude&) {}
+
+#ifdef _CLASSDESC
+#pragma omit pack minsky::PortManagerExclude
+#pragma omit unpack minsky::PortManagerExclude
+#pragma omit xml_pack minsky::PortManagerExclude
+#pragma omit xml_unpack minsky::PortManagerExclude
+#pragma omit xsd_generate minsky::PortManagerExclude
+#endif
+
 #include "portManager.cd"
 #endif
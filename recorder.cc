@@ -0,0 +1,200 @@
+/*
+  @copyright Steve Keen 2013
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "recorder.h"
+#include <ecolab_epilogue.h>
+
+#include <string.h>
+#include <algorithm>
+#if !defined(WIN32)
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace minsky
+{
+#if !defined(WIN32)
+  struct RecordingFile
+  {
+    int fd;
+    vector<string> columns;
+    size_t pageSize;
+    RecordingHeader* header;
+    double* chunk; ///< mapping of the chunk currently being written
+    size_t chunkIndex, row;
+
+    RecordingFile(const string& filename, const vector<string>& columns,
+                  size_t chunkRows):
+      fd(-1), columns(columns), pageSize(sysconf(_SC_PAGESIZE)), 
+      header(NULL), chunk(NULL), chunkIndex(0), row(0)
+    {
+      fd=::open(filename.c_str(), O_RDWR|O_CREAT|O_TRUNC, 0644);
+      if (fd<0)
+        throw error("cannot create %s", filename.c_str());
+
+      // chunks are a whole number of pages, so that each can be
+      // mapped on its own
+      size_t rowsPerPage=pageSize/sizeof(double);
+      chunkRows=max(rowsPerPage, 
+                    (chunkRows+rowsPerPage-1)/rowsPerPage*rowsPerPage);
+      size_t headerSize=sizeof(RecordingHeader)+columns.size()*sizeof(uint64_t);
+      for (size_t i=0; i<columns.size(); ++i)
+        headerSize+=columns[i].length()+1;
+      size_t dataOffset=(headerSize+pageSize-1)/pageSize*pageSize;
+
+      if (ftruncate(fd, dataOffset)!=0)
+        {
+          ::close(fd);
+          throw error("cannot extend %s", filename.c_str());
+        }
+      void* h=mmap(NULL, dataOffset, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+      if (h==MAP_FAILED)
+        {
+          ::close(fd);
+          throw error("cannot map %s", filename.c_str());
+        }
+      header=static_cast<RecordingHeader*>(h);
+      memcpy(header->magic, "MINSKYTS", 8);
+      header->version=1;
+      header->nColumns=columns.size();
+      header->chunkRows=chunkRows;
+      header->chunkBytes=chunkRows*columns.size()*sizeof(double);
+      header->dataOffset=dataOffset;
+      header->nRows=0;
+      uint64_t* offsets=reinterpret_cast<uint64_t*>(header+1);
+      char* names=reinterpret_cast<char*>(offsets+columns.size());
+      for (size_t i=0; i<columns.size(); ++i)
+        {
+          offsets[i]=i*chunkRows*sizeof(double);
+          strcpy(names, columns[i].c_str());
+          names+=columns[i].length()+1;
+        }
+      try {mapChunk(0);}
+      catch (...)
+        {
+          munmap(header, dataOffset);
+          ::close(fd);
+          throw;
+        }
+    }
+
+    ~RecordingFile()
+    {
+      if (chunk) munmap(chunk, header->chunkBytes);
+      if (header) munmap(header, header->dataOffset);
+      if (fd>=0) ::close(fd);
+    }
+
+    /// extend the file by chunk \a i, and map it for writing
+    void mapChunk(size_t i)
+    {
+      size_t offset=header->dataOffset+i*header->chunkBytes;
+      if (chunk) munmap(chunk, header->chunkBytes);
+      chunk=NULL;
+      if (ftruncate(fd, offset+header->chunkBytes)!=0)
+        throw error("cannot extend recording");
+      void* c=mmap(NULL, header->chunkBytes, PROT_READ|PROT_WRITE, 
+                   MAP_SHARED, fd, offset);
+      if (c==MAP_FAILED)
+        throw error("cannot map recording");
+      chunk=static_cast<double*>(c);
+      chunkIndex=i;
+      row=0;
+    }
+
+    double* nextRow()
+    {
+      if (row==header->chunkRows) mapChunk(chunkIndex+1);
+      return chunk+row;
+    }
+
+    void commitRow()
+    {
+      ++row;
+      // ensure the values are visible before the row count
+      __sync_synchronize();
+      header->nRows++;
+    }
+  };
+#else
+  struct RecordingFile
+  {
+    vector<string> columns;
+    RecordingFile(const string&, const vector<string>&, size_t)
+    {throw error("recording is not supported on this platform");}
+    double* nextRow() {return NULL;}
+    void commitRow() {}
+    RecordingHeader* header;
+  };
+#endif
+
+  void Recorder::open(const string& filename, const VariableManager& variables)
+  {
+    close();
+    vector<string> columns(1, "t");
+    if (names.empty())
+      {
+        for (VariableManager::VariableValues::const_iterator v=
+               variables.values.begin(); v!=variables.values.end(); ++v)
+          if (!v->second.temp())
+            columns.push_back(v->first);
+      }
+    else
+      columns.insert(columns.end(), names.begin(), names.end());
+    file.reset(new RecordingFile(filename, columns, chunkRows));
+    bind(variables);
+  }
+
+  void Recorder::bind(const VariableManager& variables)
+  {
+    if (!file) return;
+    const vector<string>& columns=file->columns;
+    values.resize(columns.size()-1);
+    for (size_t i=1; i<columns.size(); ++i)
+      {
+        VariableManager::VariableValues::const_iterator v=
+          variables.values.find(columns[i]);
+        if (v==variables.values.end())
+          {
+            close();
+            throw error("recorded variable %s no longer exists", 
+                        columns[i].c_str());
+          }
+        values[i-1]=v->second;
+      }
+  }
+
+  void Recorder::record(double t)
+  {
+    if (!file) return;
+    double* r=file->nextRow();
+    size_t stride=file->header->chunkRows;
+    r[0]=t;
+    for (size_t i=0; i<values.size(); ++i)
+      r[(i+1)*stride]=values[i].value();
+    file->commitRow();
+  }
+
+  size_t Recorder::rows() const
+  {return file? file->header->nRows: 0;}
+
+  vector<string> Recorder::columns() const
+  {return file? file->columns: vector<string>();}
+}
@@ -0,0 +1,90 @@
+/*
+  @copyright Steve Keen 2013
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include "variableManager.h"
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+namespace minsky
+{
+  using namespace std;
+
+  /**
+     Layout of the start of a recording file. The header is followed
+     by nColumns 64 bit column offsets, then nColumns NUL terminated
+     column names. Data starts at dataOffset, and consists of chunks
+     of chunkBytes, each holding chunkRows values of each column, with
+     column c at its column offset within the chunk. Rows beyond nRows
+     in the last chunk are unused.
+
+     In NumPy, column c is
+     memmap(file,float64,'r',dataOffset).reshape(-1,nColumns,chunkRows)[:,c,:].ravel()[:nRows]
+  */
+  struct RecordingHeader
+  {
+    char magic[8];       ///< "MINSKYTS"
+    uint32_t version;
+    uint32_t nColumns;
+    uint64_t chunkRows;
+    uint64_t chunkBytes;
+    uint64_t dataOffset;
+    uint64_t nRows;      ///< rows written so far, updated after each row
+  };
+
+  struct RecordingFile; // the open, memory mapped file
+
+  /**
+     Records t and selected variables after each step of the model
+     into a column oriented, memory mapped file, grown a chunk at a
+     time. The file may be read while the recording is in progress.
+  */
+  class Recorder
+  {
+    shared_ptr<RecordingFile> file;
+    vector<VariableValue> values; ///< values of the recorded variables
+  public:
+    /// variables to record. If empty, all named variables are recorded
+    vector<string> names;
+    /// number of rows per chunk, rounded up to a whole number of pages
+    size_t chunkRows;
+
+    Recorder(): chunkRows(4096) {}
+
+    bool recording() const {return file.get();}
+    /// start recording into \a filename, replacing any existing file
+    /// @throws ecolab::error if the file cannot be created
+    void open(const string& filename, const VariableManager& variables);
+    void close() {file.reset();}
+    /// update the recorded variables after the equations are rebuilt
+    /// @throws ecolab::error if a recorded variable no longer exists
+    void bind(const VariableManager& variables);
+    /// append t and the current values of the recorded variables
+    void record(double t);
+    /// number of rows recorded so far
+    size_t rows() const;
+    /// names of the recorded columns, starting with t
+    vector<string> columns() const;
+  };
+}
+
+#include "recorder.cd"
+#endif
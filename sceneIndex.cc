@@ -0,0 +1,292 @@
+/*
+  @copyright Steve Keen 2013
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "sceneIndex.h"
+#include "minsky.h"
+#include "cairoItems.h"
+#include <ecolab_epilogue.h>
+
+#include <boost/geometry/geometry.hpp>
+#include <boost/geometry/index/rtree.hpp>
+#include <algorithm>
+
+using namespace std;
+using namespace minsky;
+
+namespace minsky
+{
+  namespace bgi=boost::geometry::index;
+  typedef SceneIndex::Item Item;
+
+  /// the attributes of an item that its outline is computed from
+  struct Placement
+  {
+    float x, y, zoomFactor, width, height;
+    double rotation;
+    string name;
+    Placement(): x(0), y(0), zoomFactor(1), width(0), height(0), rotation(0) {}
+    bool operator==(const Placement& p) const {
+      return x==p.x && y==p.y && zoomFactor==p.zoomFactor && 
+        width==p.width && height==p.height && rotation==p.rotation &&
+        name==p.name;
+    }
+  };
+
+  struct SceneTree
+  {
+    struct Entry
+    {
+      Placement placement;
+      Polygon geom;
+      const void* object; ///< the item's VariableBase, OperationBase or GroupIcon
+    };
+    typedef map<Item, Entry> Entries;
+    typedef pair<Rectangle, Item> Value;
+    typedef bgi::rtree<Value, bgi::quadratic<16> > Tree;
+    Entries entries;
+    Tree tree;
+    /// the item indexed for each object, for touched(const void*)
+    map<const void*, Item> owners;
+    /// items reported as changed since the last update
+    set<Item> dirty;
+    /// whether entries reflects all the items, as counted at the last
+    /// update
+    IndexState synced;
+
+    static Value value(Entries::const_iterator e)
+    {return Value(boost::geometry::return_envelope<Rectangle>(e->second.geom), e->first);}
+
+    void disown(Entries::iterator e)
+    {
+      map<const void*, Item>::iterator o=owners.find(e->second.object);
+      if (o!=owners.end() && o->second==e->first)
+        owners.erase(o);
+    }
+
+    void erase(Entries::iterator e)
+    {
+      tree.remove(value(e));
+      disown(e);
+      entries.erase(e);
+    }
+
+    /// bring the entry of \a item up to date with \a x, recomputing
+    /// its outline only if its placement has changed. \a e is the
+    /// entry of \a item, or where it is to be inserted
+    template <class Shape, class T>
+    void place(Entries::iterator e, const Item& item, const T& x)
+    {
+      Placement p=Shape::placement(x);
+      const void* object=Shape::object(x);
+      if (e==entries.end() || !(e->first==item))
+        e=entries.insert(e, make_pair(item, Entry()));
+      else if (e->second.placement==p && e->second.object==object)
+        return;
+      else
+        {
+          tree.remove(value(e));
+          disown(e);
+        }
+      e->second.placement=p;
+      e->second.geom=Shape::geom(x);
+      e->second.object=object;
+      owners[object]=item;
+      tree.insert(value(e));
+    }
+
+    /// walk \a items alongside the entries of kind \a kind, starting at
+    /// \a e, bringing every entry up to date and dropping entries of
+    /// deleted items
+    template <class C, class Shape>
+    void sync(Entries::iterator& e, Item::Kind kind, const C& items)
+    {
+      for (typename C::const_iterator i=items.begin(); i!=items.end(); ++i)
+        {
+          Item item(kind, i->first);
+          while (e!=entries.end() && e->first<item)
+            erase(e++);
+          place<Shape>(e, item, i->second);
+          if (e!=entries.end() && e->first==item) ++e;
+        }
+    }
+
+    /// bring the entry of \a item, one of \a items, up to date
+    template <class C, class Shape>
+    void refresh(const Item& item, const C& items)
+    {
+      typename C::const_iterator i=items.find(item.id);
+      Entries::iterator e=entries.lower_bound(item);
+      if (i!=items.end())
+        place<Shape>(e, item, i->second);
+      else if (e!=entries.end() && e->first==item)
+        erase(e);
+    }
+  };
+}
+
+namespace
+{
+  // a variable's size depends on its name, which is measured by
+  // rendering it, so this is the outline most worth caching
+  struct VariableShape
+  {
+    static Placement placement(const VariablePtr& v) {
+      Placement p;
+      p.x=v->x(); p.y=v->y(); p.zoomFactor=v->zoomFactor; 
+      p.rotation=v->rotation; p.name=v->Name();
+      return p;
+    }
+    static Polygon geom(const VariablePtr& v) 
+    {return RenderVariable(v).geom();}
+    static const void* object(const VariablePtr& v) 
+    {return static_cast<const VariableBase*>(v.get());}
+  };
+
+  struct OperationShape
+  {
+    static Placement placement(const OperationPtr& o) {
+      Placement p;
+      p.x=o->x(); p.y=o->y(); p.zoomFactor=o->zoomFactor; 
+      p.rotation=o->rotation;
+      return p;
+    }
+    static Polygon geom(const OperationPtr& o) 
+    {return RenderOperation(o).geom();}
+    static const void* object(const OperationPtr& o) 
+    {return static_cast<const OperationBase*>(o.get());}
+  };
+
+  struct GroupShape
+  {
+    static Placement placement(const GroupIcon& g) {
+      Placement p;
+      p.x=g.x(); p.y=g.y(); p.zoomFactor=g.zoomFactor; 
+      p.width=g.width; p.height=g.height; p.rotation=g.rotation;
+      return p;
+    }
+    static Polygon geom(const GroupIcon& g) {return g.geom();}
+    static const void* object(const GroupIcon& g) {return &g;}
+  };
+}
+
+void SceneIndex::copy(const SceneIndex&)
+{
+  // the index refers to the objects of the model it was built from,
+  // so a copy starts afresh
+  tree.reset();
+}
+
+void SceneIndex::touched(const Item& item)
+{
+  if (tree) tree->dirty.insert(item);
+}
+
+void SceneIndex::touched(const void* object)
+{
+  if (!tree) return;
+  map<const void*, Item>::const_iterator o=tree->owners.find(object);
+  if (o!=tree->owners.end())
+    tree->dirty.insert(o->second);
+}
+
+void SceneIndex::invalidate()
+{
+  if (tree) tree->synced.invalidate();
+}
+
+void SceneIndex::update(const Minsky& m)
+{
+  if (!tree) tree.reset(new SceneTree);
+  SceneTree& t=*tree;
+
+  if (t.synced.current(t.entries.size()))
+    {
+      // items in a group are placed relative to it, so a group's
+      // contents are re-examined along with it
+      set<Item> done;
+      while (!t.dirty.empty())
+        {
+          Item item=*t.dirty.begin();
+          t.dirty.erase(t.dirty.begin());
+          if (!done.insert(item).second) continue;
+          switch (item.kind)
+            {
+            case Item::variable:
+              t.refresh<VariableManager, VariableShape>(item, m.variables);
+              break;
+            case Item::operation:
+              t.refresh<Operations, OperationShape>(item, m.operations);
+              break;
+            case Item::group:
+              {
+                t.refresh<GroupIcons, GroupShape>(item, m.groupItems);
+                GroupIcons::const_iterator g=m.groupItems.find(item.id);
+                if (g==m.groupItems.end()) break;
+                const vector<int>& v=g->second.variables();
+                for (size_t i=0; i<v.size(); ++i)
+                  t.dirty.insert(Item(Item::variable, v[i]));
+                const vector<int>& o=g->second.operations();
+                for (size_t i=0; i<o.size(); ++i)
+                  t.dirty.insert(Item(Item::operation, o[i]));
+                const vector<int>& gg=g->second.groups();
+                for (size_t i=0; i<gg.size(); ++i)
+                  t.dirty.insert(Item(Item::group, gg[i]));
+              }
+              break;
+            }
+        }
+      t.synced.update(t.entries.size());
+    }
+
+  // items added or deleted without being reported leave the count
+  // out of step, which, like invalidate(), calls for a full rescan
+  size_t numItems=m.variables.size()+m.operations.size()+m.groupItems.size();
+  if (!t.synced.current(numItems))
+    {
+      SceneTree::Entries::iterator e=t.entries.begin();
+      t.sync<VariableManager, VariableShape>(e, Item::variable, m.variables);
+      t.sync<Operations, OperationShape>(e, Item::operation, m.operations);
+      t.sync<GroupIcons, GroupShape>(e, Item::group, m.groupItems);
+      while (e!=t.entries.end())
+        t.erase(e++);
+      t.synced.update(numItems);
+    }
+  t.dirty.clear();
+}
+
+SceneIndex::Items SceneIndex::Intersecting
+(const Minsky& m, const Rectangle& r)
+{
+  update(m);
+  vector<SceneTree::Value> candidates;
+  tree->tree.query(bgi::intersects(r), back_inserter(candidates));
+  Items items;
+  for (size_t i=0; i<candidates.size(); ++i)
+    if (boost::geometry::intersects(r, geom(candidates[i].second)))
+      items.push_back(candidates[i].second);
+  sort(items.begin(), items.end());
+  return items;
+}
+
+const Polygon& SceneIndex::geom(const Item& item) const
+{
+  SceneTree::Entries::const_iterator e;
+  if (!tree || (e=tree->entries.find(item))==tree->entries.end())
+    throw error("item %d not in scene index", item.id);
+  return e->second.geom;
+}
@@ -0,0 +1,92 @@
+/*
+  @copyright Steve Keen 2013
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+   @file spatial index of the canvas items, for selecting the items
+   within a rectangle
+*/
+#ifndef SCENEINDEX_H
+#define SCENEINDEX_H
+
+#include "geometry.h"
+#include <TCL_obj_base.h>
+#include <vector>
+
+namespace minsky
+{
+  using namespace std;
+  class Minsky;
+  struct SceneTree; // the R-tree and cached outlines
+
+  /**
+     R-tree of the outlines of the variables, operations and groups of
+     a model. Each outline is cached along with the position, size,
+     rotation and zoom it was computed from.
+
+     The mutators of items, and the TCL proxies through which they are
+     edited, report the items they change with touched(), and a query
+     re-examines only those. Items report their object rather than
+     their id, which they do not know, and the index maps it back.
+     Changes affecting every item, such as zooming or loading a model,
+     call invalidate() instead, as do changes in the number of items
+     not reported through touched().
+  */
+  class SceneIndex
+  {
+    CLASSDESC_ACCESS(SceneIndex);
+    classdesc::shared_ptr<SceneTree> tree;
+    void copy(const SceneIndex&);
+  public:
+    struct Item
+    {
+      enum Kind {variable, operation, group};
+      Kind kind;
+      int id;
+      Item(Kind kind=variable, int id=-1): kind(kind), id(id) {}
+      bool operator<(const Item& x) const {
+        return kind<x.kind || (kind==x.kind && id<x.id);
+      }
+      bool operator==(const Item& x) const {return kind==x.kind && id==x.id;}
+    };
+    /// items in order of kind, then id
+    typedef vector<Item> Items;
+
+    SceneIndex() {}
+    SceneIndex(const SceneIndex& x) {copy(x);}
+    SceneIndex& operator=(const SceneIndex& x) {copy(x); return *this;}
+
+    /// bring the index up to date with the items of \a m
+    void update(const Minsky& m);
+    /// \a item has been added, changed or deleted
+    void touched(const Item& item);
+    /// the variable, operation or group at \a object has changed. Does
+    /// nothing if it is not indexed, as new items are reported by id
+    void touched(const void* object);
+    /// re-examine every item at the next query
+    void invalidate();
+    /// items of \a m whose outline overlaps, or lies within, \a r
+    Items Intersecting(const Minsky& m, const Rectangle& r);
+    /// outline of \a item, as of the last update
+    /// @throws ecolab::error if \a item is not indexed
+    const Polygon& geom(const Item& item) const;
+  };
+}
+
+#include "sceneIndex.cd"
+#endif
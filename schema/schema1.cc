@@ -361,6 +361,9 @@ namespace schema1
     c.populate(m.wires, model.wires);
     c.populate(m.operations, model.operations);
     c.populate(m.variables, model.variables);
+    // populate assigns to the maps directly
+    m.portsChanged();
+    m.wiresChanged();
     m.variables.makeConsistent();
     c.populate(m.godleyItems, model.godleys);
     c.populate(m.groupItems, model.groups);
@@ -420,6 +423,7 @@ namespace schema1
     m.nSteps=model.rungeKutta.nSteps;   
     m.epsAbs=model.rungeKutta.epsAbs;   
     m.epsRel=model.rungeKutta.epsRel;   
+    m.stepper=model.rungeKutta.stepper;
     
     return m;
   }
@@ -565,6 +569,9 @@ namespace schema1
     c.populate(minsky().wires, wires);
     c.populate(minsky().operations, model.operations);
     c.populate(minsky().variables, model.variables);
+    // populate assigns to the maps directly
+    minsky().portsChanged();
+    minsky().wiresChanged();
     minsky().variables.makeConsistent();
     c.populate(minsky().groupItems, model.groups);
 
@@ -769,5 +776,53 @@ namespace schema1
       }
   }
 
-}
+  namespace
+  {
+    /// unpack a layout written by Layout::pack into a UnionLayout, as
+    /// is done for the XML representation
+    shared_ptr<Layout> unpackLayout(unpack_t& x)
+    {
+      int type;
+      ::unpack(x,"",type);
+      UnionLayout* u=new UnionLayout;
+      shared_ptr<Layout> r(u);
+      switch (type)
+        {
+        case Layout::position: ::unpack(x,"",static_cast<PositionLayout&>(*u)); break;
+        case Layout::visibility: ::unpack(x,"",static_cast<VisibilityLayout&>(*u)); break;
+        case Layout::wire: ::unpack(x,"",static_cast<WireLayout&>(*u)); break;
+        case Layout::item: ::unpack(x,"",static_cast<ItemLayout&>(*u)); break;
+        case Layout::group: ::unpack(x,"",static_cast<GroupLayout&>(*u)); break;
+        case Layout::slider: ::unpack(x,"",static_cast<SliderLayout&>(*u)); break;
+        case Layout::unionType: ::unpack(x,"",*u); break;
+        default:
+          throw ecolab::error("invalid layout type %d", type);
+        }
+      return r;
+    }
+  }
+
+  void Minsky::packBinary(pack_t& x) const
+  {
+    ::pack(x,"",const_cast<int&>(schemaVersion));
+    ::pack(x,"",const_cast<MinskyModel&>(model));
+    size_t n=layout.size();
+    ::pack(x,"",n);
+    for (size_t i=0; i<n; ++i)
+      layout[i]->pack(x);
+    ::pack(x,"",const_cast<float&>(zoomFactor));
+  }
 
+  void Minsky::unpackBinary(unpack_t& x)
+  {
+    ::unpack(x,"",schemaVersion);
+    ::unpack(x,"",model);
+    size_t n;
+    ::unpack(x,"",n);
+    layout.clear();
+    for (size_t i=0; i<n; ++i)
+      layout.push_back(unpackLayout(x));
+    ::unpack(x,"",zoomFactor);
+  }
+
+}
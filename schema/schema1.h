@@ -115,13 +115,19 @@ namespace schema1
 
   template <class T> 
   void xml_pack_layout(xml_pack_t& x, const string& d, const T& a);
+  template <class T> 
+  void pack_layout(pack_t& x, int type, const T& a);
 
   struct Layout
   {
+    /// identifies the layout class in the binary format
+    enum Type {position, visibility, wire, item, group, slider, unionType};
     int id;
     Layout(int id=-1): id(id) {}
     virtual ~Layout() {}
     virtual void xml_pack(xml_pack_t&, const string&) const=0;
+    /// binary serialisation, preceded by the layout Type
+    virtual void pack(pack_t&) const=0;
   };
 
   /// represent objects whose layouts just have a position (ports,
@@ -135,6 +141,7 @@ namespace schema1
       Layout(id), x(SchemaHelper::x(item)), y(SchemaHelper::y(item)) {}
     void xml_pack(xml_pack_t& x, const string& d) const
     {xml_pack_layout(x,d,*this);}
+    void pack(pack_t& x) const {pack_layout(x,position,*this);}
   };
 
   /// represents items with a visibility attribute
@@ -146,6 +153,7 @@ namespace schema1
       Layout(id), visible(item.visible) {}
     void xml_pack(xml_pack_t& x, const string& d) const
     {xml_pack_layout(x,d,*this);}
+    void pack(pack_t& x) const {pack_layout(x,visibility,*this);}
   };
 
   /// represents layouts of wires
@@ -159,6 +167,7 @@ namespace schema1
       coords(toVector(SchemaHelper::coords(wire))) {}
     void xml_pack(xml_pack_t& x, const string& d) const
     {xml_pack_layout(x,d,*this);}
+    void pack(pack_t& x) const {pack_layout(x,wire,*this);}
   };
 
   /// represents layouts of objects like variables and operators
@@ -173,6 +182,7 @@ namespace schema1
       rotation(item.rotation) {}
     void xml_pack(xml_pack_t& x, const string& d) const
     {xml_pack_layout(x,d,*this);}
+    void pack(pack_t& x) const {pack_layout(x,item,*this);}
  };
 
   /// group layouts also have a width & height
@@ -186,6 +196,7 @@ namespace schema1
       displayZoom(g.displayZoom) {}
     void xml_pack(xml_pack_t& x, const string& d) const
     {xml_pack_layout(x,d,*this);}
+    void pack(pack_t& x) const {pack_layout(x,group,*this);}
   };
 
   /// describes item with sliders - currently just constants
@@ -202,6 +213,7 @@ namespace schema1
       sliderStep(item.sliderStep) {}
     void xml_pack(xml_pack_t& x, const string& d) const
     {xml_pack_layout(x,d,*this);}
+    void pack(pack_t& x) const {pack_layout(x,slider,*this);}
   };
 
   /// structure representing a union of all of the above Layout
@@ -211,6 +223,7 @@ namespace schema1
   {
     // not used, but needed to resolve ambiguity
     void xml_pack(xml_pack_t&,const string&) const {} 
+    void pack(pack_t& x) const {pack_layout(x,unionType,*this);}
   };
 
   inline void xml_pack(xml_pack_t& x, const string& d, 
@@ -229,10 +242,11 @@ namespace schema1
     double stepMin, stepMax;
     int nSteps;
     double epsRel, epsAbs;
-    RungeKutta() {}
+    OdeStepper::Type stepper;
+    RungeKutta(): stepper(OdeStepper::rkf45) {}
     RungeKutta(const minsky::Minsky& m):
       stepMin(m.stepMin), stepMax(m.stepMax), nSteps(m.nSteps),
-      epsRel(m.epsRel), epsAbs(m.epsAbs) {}
+      epsRel(m.epsRel), epsAbs(m.epsAbs), stepper(m.stepper) {}
   };
 
   struct MinskyModel
@@ -268,6 +282,10 @@ namespace schema1
     void populateGroup(minsky::GroupIcon& g);
     /// move locations such that minx, miny lies at (0,0) on canvas
     void relocateCanvas();
+
+    /// compact binary equivalent of the XML representation
+    void packBinary(pack_t&) const;
+    void unpackBinary(unpack_t&);
   };
 }
 
@@ -299,6 +317,13 @@ namespace schema1
     //    ::xml_pack(x,d+".type",typeName<T>());
     ::xml_pack(x,d,a);
   }
+
+  template <class T> 
+  void pack_layout(pack_t& x, int type, const T& a)
+  {
+    ::pack(x,"",type);
+    ::pack(x,"",const_cast<T&>(a));
+  }
 }
 
 #endif
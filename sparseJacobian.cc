@@ -0,0 +1,155 @@
+/*
+  @copyright Steve Keen 2013
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "sparseJacobian.h"
+#include <ecolab_epilogue.h>
+
+#include <algorithm>
+
+namespace minsky
+{
+  namespace
+  {
+    /// merge the sorted set \a y into sorted set \a x
+    void merge(vector<int>& x, const vector<int>& y)
+    {
+      if (y.empty()) return;
+      size_t n=x.size();
+      x.insert(x.end(), y.begin(), y.end());
+      inplace_merge(x.begin(), x.begin()+n, x.end());
+      x.erase(unique(x.begin(), x.end()), x.end());
+    }
+
+    /// insert \a y into sorted set \a x
+    void merge(vector<int>& x, int y)
+    {
+      vector<int>::iterator p=lower_bound(x.begin(), x.end(), y);
+      if (p==x.end() || *p!=y) x.insert(p, y);
+    }
+  }
+
+  double SparseMatrix::operator()(size_t i, size_t j) const
+  {
+    assert(i<n && j<n);
+    vector<int>::const_iterator begin=col.begin()+rowStart[i],
+      end=col.begin()+rowStart[i+1], p=lower_bound(begin, end, int(j));
+    if (p!=end && *p==int(j))
+      return value[p-col.begin()];
+    return 0;
+  }
+
+  void JacobianPattern::clear()
+  {
+    n=0; nColours=0;
+    rowStart.clear(); col.clear(); colour.clear(); source.clear();
+  }
+
+  void JacobianPattern::build
+  (const EvalTape& tape, size_t nStocks, size_t nFlows,
+   const vector<pair<int,int> >& flowInputs,
+   const vector<pair<int,int> >& stockInputs)
+  {
+    vector<int> newSource;
+    newSource.reserve(5*tape.size()+2*(flowInputs.size()+stockInputs.size())+4);
+    newSource.push_back(nStocks);
+    newSource.push_back(nFlows);
+    newSource.push_back(tape.size());
+    newSource.push_back(flowInputs.size());
+    for (size_t i=0; i<tape.size(); ++i)
+      {
+        newSource.push_back(tape.opcode[i]);
+        newSource.push_back(tape.out[i]);
+        newSource.push_back(tape.in1[i]);
+        newSource.push_back(tape.in2[i]);
+        newSource.push_back(tape.flags[i]);
+      }
+    for (size_t i=0; i<flowInputs.size(); ++i)
+      {
+        newSource.push_back(flowInputs[i].first);
+        newSource.push_back(flowInputs[i].second);
+      }
+    for (size_t i=0; i<stockInputs.size(); ++i)
+      {
+        newSource.push_back(stockInputs[i].first);
+        newSource.push_back(stockInputs[i].second);
+      }
+    if (newSource==source) return;
+
+    clear();
+    source.swap(newSource);
+    n=nStocks;
+
+    // the set of stocks each flow variable depends on
+    vector<vector<int> > flowDeps(nFlows);
+    for (size_t i=0; i<tape.size(); ++i)
+      {
+        vector<int>& deps=flowDeps[tape.out[i]];
+        if (tape.opcode[i]==OperationType::constant ||
+            tape.opcode[i]==OperationType::time)
+          continue;
+        bool f1=tape.flags[i]&EvalTape::flow1Bit,
+          f2=tape.flags[i]&EvalTape::flow2Bit;
+        if (f1)
+          merge(deps, flowDeps[tape.in1[i]]);
+        else
+          merge(deps, tape.in1[i]);
+        if (!tape.binary(i)) continue;
+        if (f2)
+          merge(deps, flowDeps[tape.in2[i]]);
+        else
+          merge(deps, tape.in2[i]);
+      }
+
+    vector<vector<int> > rows(nStocks);
+    for (size_t i=0; i<flowInputs.size(); ++i)
+      merge(rows[flowInputs[i].first], flowDeps[flowInputs[i].second]);
+    for (size_t i=0; i<stockInputs.size(); ++i)
+      merge(rows[stockInputs[i].first], stockInputs[i].second);
+
+    rowStart.push_back(0);
+    for (size_t i=0; i<nStocks; ++i)
+      {
+        col.insert(col.end(), rows[i].begin(), rows[i].end());
+        rowStart.push_back(col.size());
+      }
+
+    // greedy colouring: each column takes the lowest colour not used
+    // by a column sharing one of its rows
+    vector<vector<int> > colRows(nStocks);
+    for (size_t i=0; i<nStocks; ++i)
+      for (int p=rowStart[i]; p<rowStart[i+1]; ++p)
+        colRows[col[p]].push_back(i);
+
+    colour.assign(nStocks, -1);
+    vector<int> forbiddenFor(nStocks+1, -1);
+    for (size_t j=0; j<nStocks; ++j)
+      {
+        for (size_t r=0; r<colRows[j].size(); ++r)
+          {
+            int row=colRows[j][r];
+            for (int p=rowStart[row]; p<rowStart[row+1]; ++p)
+              if (colour[col[p]]>=0)
+                forbiddenFor[colour[col[p]]]=j;
+          }
+        int c=0;
+        while (forbiddenFor[c]==int(j)) ++c;
+        colour[j]=c;
+        nColours=max(nColours, c+1);
+      }
+  }
+}
@@ -0,0 +1,78 @@
+/*
+  @copyright Steve Keen 2013
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef SPARSEJACOBIAN_H
+#define SPARSEJACOBIAN_H
+
+#include "evalTape.h"
+#include <vector>
+#include <utility>
+
+namespace minsky
+{
+  using namespace std;
+
+  /// square matrix in compressed sparse row form
+  struct SparseMatrix
+  {
+    size_t n; ///< number of rows (and columns)
+    /// start of each row in col and value, with rowStart[n]=nonZeros()
+    vector<int> rowStart;
+    vector<int> col;      ///< column of each entry, ascending within a row
+    vector<double> value; ///< value of each entry
+
+    SparseMatrix(): n(0) {}
+    size_t nonZeros() const {return col.size();}
+    /// element (i,j), which is zero if not in the sparsity pattern
+    double operator()(size_t i, size_t j) const;
+  };
+
+  /**
+     structural sparsity of the Jacobian of the stock variable
+     derivatives with respect to the stock variables, together with a
+     colouring of its columns, such that no two columns of the same
+     colour have an entry in the same row. All columns of a colour can
+     then be recovered from a single tangent direction.
+  */
+  struct JacobianPattern
+  {
+    size_t n; ///< number of stock variables
+    vector<int> rowStart, col; ///< pattern in CSR form, as SparseMatrix
+    vector<int> colour; ///< colour of each column
+    int nColours;
+    /// the arguments of the last build(), encoded as integers, so
+    /// that rebuilding an unchanged model is cheap
+    vector<int> source;
+
+    JacobianPattern(): n(0), nColours(0) {}
+    void clear();
+
+    /// build the pattern for \a nStocks stocks and \a nFlows flow
+    /// variables, where the flow variables are computed by \a tape,
+    /// and stock derivative s receives contributions from flow f for
+    /// each (s,f) in \a flowInputs, and from stock c for each (s,c)
+    /// in \a stockInputs. Does nothing if these are the same as the
+    /// previous call.
+    void build(const EvalTape& tape, size_t nStocks, size_t nFlows,
+               const vector<pair<int,int> >& flowInputs,
+               const vector<pair<int,int> >& stockInputs);
+  };
+}
+
+#include "sparseJacobian.cd"
+#endif
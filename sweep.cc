@@ -0,0 +1,177 @@
+/*
+  @copyright Steve Keen 2013
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "sweep.h"
+#include "minsky.h"
+#include "threadPool.h"
+#include "str.h"
+#include <schema/schema1.h>
+#include <ecolab_epilogue.h>
+
+#include <gsl/gsl_rng.h>
+#include <gsl/gsl_randist.h>
+#include <limits>
+#include <algorithm>
+#include <iterator>
+
+namespace minsky
+{
+  void Sweep::addGrid(int id, double min, double max, int n)
+  {
+    if (n<1) throw error("grid needs at least one point");
+    parameters.push_back(Parameter(id, grid, min, max, n));
+  }
+
+  void Sweep::addUniform(int id, double min, double max)
+  {parameters.push_back(Parameter(id, uniform, min, max));}
+
+  void Sweep::addNormal(int id, double mean, double stddev)
+  {parameters.push_back(Parameter(id, normal, mean, stddev));}
+
+  namespace
+  {
+    /// simulates the runs of a sweep, each on a private copy of the
+    /// model
+    struct SweepRuns: public ThreadPool::Task
+    {
+      const Sweep& sweep;
+      const schema1::Minsky& snapshot;
+      /// position of each parameter in the operation map. The schema
+      /// renumbers items, but preserves their order
+      const vector<size_t>& opPos;
+      const vector<double>& values; ///< parameter values of each run
+      vector<double>& results;
+      SweepRuns(const Sweep& sweep, const schema1::Minsky& snapshot, 
+                const vector<size_t>& opPos, const vector<double>& values,
+                vector<double>& results):
+        sweep(sweep), snapshot(snapshot), opPos(opPos), values(values), 
+        results(results) {}
+
+      void operator()(size_t begin, size_t end)
+      {
+        for (size_t r=begin; r<end; ++r) run(r);
+      }
+
+      void run(size_t r)
+      {
+        size_t nParams=sweep.parameters.size();
+        double* row=&results[r*sweep.columns.size()];
+        for (size_t p=0; p<nParams; ++p)
+          row[p]=values[r*nParams+p];
+        for (size_t c=nParams; c<sweep.columns.size(); ++c)
+          row[c]=numeric_limits<double>::quiet_NaN();
+
+        try
+          {
+            Minsky model;
+            LocalMinsky lm(model);
+            model=snapshot;
+            for (size_t p=0; p<nParams; ++p)
+              {
+                Operations::iterator op=model.operations.begin();
+                advance(op, opPos[p]);
+                dynamic_cast<Constant&>(*op->second).value=row[p];
+              }
+            model.markEdited();
+            double lastT=-1;
+            while (model.t<sweep.horizon && model.t>lastT)
+              {
+                lastT=model.t;
+                model.step();
+              }
+            row[nParams]=model.t;
+            for (size_t o=0; o<sweep.outputs.size(); ++o)
+              row[nParams+1+o]=model.variables.values[sweep.outputs[o]].value();
+          }
+        catch (...) {} // failed runs are left as NaN
+      }
+    };
+  }
+
+  void Sweep::run(const Minsky& m)
+  {
+    columns.clear();
+    results.clear();
+    vector<size_t> opPos;
+    for (size_t p=0; p<parameters.size(); ++p)
+      {
+        Operations::const_iterator op=m.operations.find(parameters[p].id);
+        if (op==m.operations.end() || 
+            op->second->type()!=OperationType::constant)
+          throw error("operation %d is not a constant", parameters[p].id);
+        opPos.push_back(distance(m.operations.begin(), op));
+        columns.push_back(str(parameters[p].id));
+      }
+    columns.push_back("t");
+    for (size_t o=0; o<outputs.size(); ++o)
+      {
+        if (m.variables.values.count(outputs[o])==0)
+          throw error("unknown variable %s", outputs[o].c_str());
+        columns.push_back(outputs[o]);
+      }
+
+    // enumerate the grid, drawing the random parameters afresh for
+    // each sample. Values are drawn up front so that results do not
+    // depend on the number of threads.
+    size_t nGrid=1;
+    bool random=false;
+    for (size_t p=0; p<parameters.size(); ++p)
+      if (parameters[p].distribution==grid)
+        nGrid*=parameters[p].n;
+      else
+        random=true;
+    size_t samples=random? max(nSamples,1): 1;
+    size_t nRuns=nGrid*samples, nParams=parameters.size();
+
+    vector<double> values(nRuns*nParams);
+    gsl_rng* rng=gsl_rng_alloc(gsl_rng_mt19937);
+    gsl_rng_set(rng, seed);
+    for (size_t r=0; r<nRuns; ++r)
+      {
+        size_t g=r/samples; // mixed radix index into the grid
+        for (size_t p=0; p<nParams; ++p)
+          {
+            const Parameter& par=parameters[p];
+            double& v=values[r*nParams+p];
+            switch (par.distribution)
+              {
+              case grid:
+                {
+                  int i=g%par.n;
+                  g/=par.n;
+                  v=par.n>1? par.a+i*(par.b-par.a)/(par.n-1): par.a;
+                  break;
+                }
+              case uniform:
+                v=par.a+(par.b-par.a)*gsl_rng_uniform(rng);
+                break;
+              case normal:
+                v=par.a+gsl_ran_gaussian(rng, par.b);
+                break;
+              }
+          }
+      }
+    gsl_rng_free(rng);
+
+    results.resize(nRuns*columns.size());
+    schema1::Minsky snapshot(m);
+    SweepRuns runs(*this, snapshot, opPos, values, results);
+    ThreadPool pool(max(nThreads,1));
+    pool.parallelFor(nRuns, 1, runs);
+  }
+}
@@ -0,0 +1,87 @@
+/*
+  @copyright Steve Keen 2013
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <vector>
+#include <string>
+
+namespace minsky
+{
+  using namespace std;
+  class Minsky;
+
+  /**
+     A parameter sweep, or Monte Carlo study, over the Constant
+     operations of a model. Each run simulates its own copy of the
+     model, and runs are distributed over a pool of threads.
+  */
+  struct Sweep
+  {
+    /// how values of a parameter are chosen
+    enum Distribution {grid, uniform, normal};
+    struct Parameter
+    {
+      int id; ///< Constant operation id
+      Distribution distribution;
+      /// grid: range min..max in n points. uniform: range
+      /// a..b. normal: mean a, standard deviation b
+      double a, b;
+      int n;
+      Parameter(int id=-1, Distribution d=grid, double a=0, double b=0, int n=1):
+        id(id), distribution(d), a(a), b(b), n(n) {}
+    };
+    vector<Parameter> parameters;
+    vector<string> outputs; ///< names of variables to record
+    double horizon; ///< simulation time of each run
+    /// number of random draws for each point of the parameter grid
+    int nSamples;
+    int nThreads;
+    unsigned long seed; ///< random number seed
+
+    /// column names of results: each parameter's id, the final time,
+    /// then outputs
+    vector<string> columns;
+    /// row major table of nRuns() rows by columns.size(). Outputs of
+    /// runs that fail are NaN.
+    vector<double> results;
+
+    Sweep(): horizon(1), nSamples(1), nThreads(1), seed(0) {}
+
+    /// sweep Constant \a id over \a n points in [\a min, \a max]
+    void addGrid(int id, double min, double max, int n);
+    /// draw Constant \a id uniformly from [\a min, \a max)
+    void addUniform(int id, double min, double max);
+    /// draw Constant \a id from a normal distribution
+    void addNormal(int id, double mean, double stddev);
+    void addOutput(const string& name) {outputs.push_back(name);}
+    void clear() {parameters.clear(); outputs.clear(); results.clear(); columns.clear();}
+
+    /// run the sweep over copies of \a m, filling results
+    /// @throws ecolab::error if a parameter or output does not exist
+    void run(const Minsky& m);
+
+    size_t nRuns() const {return columns.empty()? 0: results.size()/columns.size();}
+    double result(size_t run, size_t column) const 
+    {return results[run*columns.size()+column];}
+  };
+}
+
+#include "sweep.cd"
+#endif
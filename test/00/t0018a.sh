@@ -0,0 +1,55 @@
+#! /bin/sh
+
+here=`pwd`
+if test $? -ne 0; then exit 2; fi
+tmp=/tmp/$$
+mkdir $tmp
+if test $? -ne 0; then exit 2; fi
+cd $tmp
+if test $? -ne 0; then exit 2; fi
+
+fail()
+{
+    echo "FAILED" 1>&2
+    cd $here
+    chmod -R u+w $tmp
+    rm -rf $tmp
+    exit 1
+}
+
+pass()
+{
+    echo "PASSED" 1>&2
+    cd $here
+    chmod -R u+w $tmp
+    rm -rf $tmp
+    exit 0
+}
+
+trap "fail" 1 2 3 15
+
+# checks that the headless batch runner produces one row per step,
+# in both output formats
+$here/minsky-batch -n 10 -o out.csv $here/examples/exponentialGrowth.mky
+if test $? -ne 0; then fail; fi
+if test `wc -l <out.csv` -ne 11; then fail; fi
+head -1 out.csv | grep '^t,' >/dev/null
+if test $? -ne 0; then fail; fi
+
+$here/minsky-batch -n 10 -f binary -o out.bin $here/examples/exponentialGrowth.mky
+if test $? -ne 0; then fail; fi
+header=`head -1 out.bin`
+ncols=`echo $header | wc -w`
+size=`wc -c <out.bin`
+if test $size -ne `expr ${#header} + 1 + 80 \* $ncols`; then fail; fi
+
+# unknown variables are an error
+$here/minsky-batch -v noSuchVariable $here/examples/exponentialGrowth.mky >out.csv 2>/dev/null
+if test $? -eq 0; then fail; fi
+
+# an end time runs until it is reached
+$here/minsky-batch -t 5 $here/examples/exponentialGrowth.mky >out.csv
+if test $? -ne 0; then fail; fi
+tail -1 out.csv | awk -F, '{if ($1<5) exit 1}'
+if test $? -ne 0; then fail; fi
+pass
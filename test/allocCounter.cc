@@ -0,0 +1,57 @@
+/*
+  @copyright Steve Keen 2013
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// replaces the global allocation functions with versions that count
+// calls, so that tests can assert on regions that should not touch
+// the heap
+#include "allocCounter.h"
+#include <new>
+#include <stdlib.h>
+
+namespace
+{
+  size_t count=0;
+
+  void* countedAlloc(size_t sz)
+  {
+    __sync_fetch_and_add(&count, 1);
+    if (void* p=malloc(sz? sz: 1))
+      return p;
+    throw std::bad_alloc();
+  }
+}
+
+// dynamic exception specifications are required before C++11, and
+// invalid from C++17
+#if __cplusplus < 201103L
+#define THROWS_BAD_ALLOC throw(std::bad_alloc)
+#define NOTHROW throw()
+#else
+#define THROWS_BAD_ALLOC
+#define NOTHROW noexcept
+#endif
+
+size_t allocationCount() {return __sync_fetch_and_add(&count, 0);}
+
+void* operator new(size_t sz) THROWS_BAD_ALLOC
+{return countedAlloc(sz);}
+void* operator new[](size_t sz) THROWS_BAD_ALLOC
+{return countedAlloc(sz);}
+void operator delete(void* p) NOTHROW {free(p);}
+void operator delete[](void* p) NOTHROW {free(p);}
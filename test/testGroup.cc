@@ -238,6 +238,38 @@ SUITE(Group)
     CHECK(uniqueGroupMembership());
   }
 
+  // groupTest follows groups as they are added, moved, zoomed and
+  // deleted, and picks the smallest of nested groups
+  TEST_FIXTURE(TestFixture, ContainingGroup)
+  {
+    GroupIcon& g=groupItems[0];
+    groupTest.initGroupList(groupItems);
+    CHECK_EQUAL(0, groupTest.ContainingGroup(g.x(),g.y()));
+    CHECK_EQUAL(-1, groupTest.ContainingGroup(1000,1000));
+
+    GroupIcon& g1=groupItems[1]=GroupIcon(1);
+    g1.width=g1.height=10;
+    g1.MoveTo(g.x(),g.y());
+    groupTest.initGroupList(groupItems);
+    CHECK_EQUAL(1, groupTest.ContainingGroup(g.x(),g.y()));
+    // excluding a group ignores it
+    groupTest.initGroupList(groupItems, 1);
+    CHECK_EQUAL(0, groupTest.ContainingGroup(g.x(),g.y()));
+
+    g.MoveTo(1000,1000);
+    groupTest.initGroupList(groupItems);
+    CHECK_EQUAL(0, groupTest.ContainingGroup(1000,1000));
+    CHECK_EQUAL(1, groupTest.ContainingGroup(g1.x(),g1.y()));
+
+    g1.zoomFactor=0.1;
+    groupTest.initGroupList(groupItems);
+    CHECK_EQUAL(-1, groupTest.ContainingGroup(g1.x()+2,g1.y()));
+
+    groupItems.erase(0);
+    groupTest.initGroupList(groupItems);
+    CHECK_EQUAL(-1, groupTest.ContainingGroup(1000,1000));
+  }
+
   // test that the new IO variables created do not introduce
   // extraneous references
   TEST_FIXTURE(Minsky, NewIOVariables)
@@ -17,8 +17,13 @@
   along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "../minsky.h"
+#include "../compiledModel.h"
+#include "../str.h"
+#include "allocCounter.h"
 #include <UnitTest++/UnitTest++.h>
 #include <gsl/gsl_integration.h>
+#include <pthread.h>
+#include <fstream>
 using namespace minsky;
 
 namespace
@@ -226,6 +231,35 @@ TEST_FIXTURE(TestFixture,godleyEval)
    
 }
 
+// numerical prefixes, repeated flows and reversed sign conventions
+// in the compiled Godley tables
+TEST_FIXTURE(TestFixture,godleyIncidence)
+{
+  GodleyTable& godley=godleyItems[0].table;
+  godley.Resize(4,4);
+  godley.cell(0,1)="c";
+  godley.cell(0,2)="d";
+  godley.cell(0,3)="e";
+  godley.cell(2,1)="2a";
+  godley.cell(2,2)="-a";
+  godley.cell(3,1)="a";
+  godley.cell(3,3)="-0.5 a";
+  godley.doubleEntryCompliant=true;
+  godley._assetClass(3, GodleyTable::liability);
+  godleyItems[0].update();
+  variables.values["a"].init=5;
+
+  garbageCollect();
+  reset();
+  CHECK_EQUAL(3, godleyIncidence.nonZeros());
+  for (size_t i=0; i<stockVars.size(); ++i)
+    stockVars[i]=0;
+  godleyEval(&stockVars[0], &flowVars[0]);
+  CHECK_EQUAL(15,variables.values["c"].value());
+  CHECK_EQUAL(-5,variables.values["d"].value());
+  CHECK_EQUAL(2.5,variables.values["e"].value());
+}
+
 /*
   ASCII Art diagram for the below test:
 
@@ -308,6 +342,207 @@ TEST_FIXTURE(TestFixture,derivative)
   CHECK_EQUAL(0,jac(3,3));
 }
 
+// check native code agrees with the interpreted equations, using
+// the same network as the derivative test
+TEST_FIXTURE(TestFixture,compiledModel)
+{
+  GodleyTable& godley=godleyItems[0].table;
+  godley.Resize(3,4);
+  godley.cell(0,1)="c";
+  godley.cell(0,2)="d";
+  godley.cell(0,3)="e";
+  godley.cell(2,1)="a";
+  godley.cell(2,2)="-b";
+  godley.cell(2,3)="f";
+  godleyItems[0].update();
+
+  map<string, VariablePtr> var;
+  for (VariableManager::iterator v=variables.begin(); v!=variables.end(); ++v)
+    var[v->second->Name()]=v->second;
+
+  operations[1]=OperationPtr(OperationType::add);
+  operations[2]=OperationPtr(OperationType::integrate);
+  operations[3]=OperationPtr(OperationType::multiply);
+
+  addWire(Wire(var["e"]->outPort(), var["f"]->inPort()));
+  addWire(Wire(var["c"]->outPort(), operations[1]->ports()[1]));
+  addWire(Wire(var["d"]->outPort(), operations[1]->ports()[2]));;
+  addWire(Wire(operations[1]->ports()[0], operations[2]->ports()[1]));
+  addWire(Wire(operations[2]->ports()[0], var["a"]->inPort()));
+  addWire(Wire(operations[2]->ports()[0], operations[3]->ports()[1]));
+  addWire(Wire(var["e"]->outPort(), operations[3]->ports()[2]));
+  addWire(Wire(operations[3]->ports()[0], var["b"]->inPort()));
+
+  constructEquations();
+  variables.values["c"]=100;
+  variables.values["d"]=200;
+  variables.values["e"]=300;
+  stockVars.back()=2;
+  size_t n=stockVars.size();
+
+  CompiledModel cm(*this);
+  vector<double> r1(n), r2(n);
+  evalEquations(&r1[0], &stockVars[0]);
+  cm.evalEquations(*this, &r2[0], &stockVars[0]);
+  CHECK_ARRAY_CLOSE(r1, r2, n, 1e-10);
+
+  vector<double> j1(n*n), j2(n*n);
+  Matrix jac1(n,&j1[0]), jac2(n,&j2[0]);
+  jacobian(jac1, &stockVars[0]);
+  cm.jacobian(*this, jac2, &stockVars[0]);
+  CHECK_ARRAY_CLOSE(j1, j2, n*n, 1e-10);
+
+  // a second instance of the same model is served from the cache
+  CompiledModel cm2(*this);
+  CHECK_EQUAL(cm.libName, cm2.libName);
+
+  // a cache entry holding different source under the same name, as
+  // after a hash collision, is not reused, even though its library
+  // is already loaded
+  string srcName=cm.libName.substr(0, cm.libName.size()-3)+".cc";
+  {
+    ofstream f(srcName.c_str());
+    f<<"// another model\n";
+  }
+  CompiledModel cm3(*this);
+  CHECK(cm3.libName!=cm.libName);
+  cm3.evalEquations(*this, &r2[0], &stockVars[0]);
+  CHECK_ARRAY_CLOSE(r1, r2, n, 1e-10);
+  {
+    ofstream f(srcName.c_str());
+    f<<cm.source;
+  }
+}
+
+/*
+  check the lowered equation tape agrees with the EvalOp objects
+
+  a - sin --
+             \
+              * -- c
+             /
+  b - exp --
+*/
+TEST_FIXTURE(TestFixture,evalTape)
+{
+  VariablePtr varA = variables[variables.newVariable("a")];
+  VariablePtr varB = variables[variables.newVariable("b")];
+  VariablePtr varC = variables[variables.newVariable("c")];
+  variables.values["a"].init=0.3;
+  variables.values["b"].init=0.7;
+
+  OperationPtr& sinOp=operations[0]=OperationPtr(OperationType::sin);
+  OperationPtr& expOp=operations[1]=OperationPtr(OperationType::exp);
+  OperationPtr& mulOp=operations[2]=OperationPtr(OperationType::multiply);
+
+  addWire(Wire(varA->outPort(), sinOp->ports()[1]));
+  addWire(Wire(varB->outPort(), expOp->ports()[1]));
+  addWire(Wire(sinOp->ports()[0], mulOp->ports()[1]));
+  addWire(Wire(expOp->ports()[0], mulOp->ports()[2]));
+  addWire(Wire(mulOp->ports()[0], varC->inPort()));
+
+  constructEquations();
+  CHECK(tape.size()<=equations.size());
+
+  // the optimised tape need only agree on named variables
+  vector<double> f1(flowVars), f2(flowVars);
+  for (size_t i=0; i<equations.size(); ++i)
+    equations[i]->eval(&f1[0], &stockVars[0]);
+  evalFlowVars(&f2[0], &stockVars[0]);
+  for (VariableManager::VariableValues::iterator v=variables.values.begin();
+       v!=variables.values.end(); ++v)
+    CHECK_CLOSE(f1[v->second.idx()], f2[v->second.idx()], 1e-10);
+  CHECK_CLOSE(sin(0.3)*exp(0.7), f2[variables.values["c"].idx()], 1e-10);
+
+  // invalid operations are still reported as errors
+  variables.values["b"]=1000;
+  CHECK_THROW(evalFlowVars(&f2[0], &stockVars[0]), ecolab::error);
+}
+
+// identity temporaries, copies and unused results are optimised away
+TEST_FIXTURE(TestFixture,optimiseTape)
+{
+  VariablePtr varA = variables[variables.newVariable("a")];
+  VariablePtr varC = variables[variables.newVariable("c")];
+  variables.values["a"].init=2;
+
+  OperationPtr& addOp=operations[0]=OperationPtr(OperationType::add);
+  OperationPtr& mulOp=operations[1]=OperationPtr(OperationType::multiply);
+  OperationPtr& sinOp=operations[2]=OperationPtr(OperationType::sin);
+  // a+0 feeds 1*(a+0), whose result is c. sin(a) goes nowhere
+  addWire(Wire(varA->outPort(), addOp->ports()[1]));
+  addWire(Wire(addOp->ports()[0], mulOp->ports()[2]));
+  addWire(Wire(mulOp->ports()[0], varC->inPort()));
+  addWire(Wire(varA->outPort(), sinOp->ports()[1]));
+
+  constructEquations();
+  CHECK(tape.size()<equations.size());
+  for (size_t i=0; i<tape.size(); ++i)
+    CHECK(tape.opcode[i]!=OperationType::sin);
+
+  vector<double> f(flowVars);
+  evalFlowVars(&f[0], &stockVars[0]);
+  CHECK_EQUAL(2, f[variables.values["c"].idx()]);
+
+  // named inputs are read live, rather than folded
+  variables.values["a"]=3;
+  evalFlowVars(&flowVars[0], &stockVars[0]);
+  CHECK_EQUAL(3, variables.values["c"].value());
+}
+
+// an operation wired straight into a plot is kept by the optimiser
+TEST_FIXTURE(TestFixture,plotInputsObserved)
+{
+  VariablePtr varA = variables[variables.newVariable("a")];
+  OperationPtr& sinOp=operations[0]=OperationPtr(OperationType::sin);
+  addWire(Wire(varA->outPort(), sinOp->ports()[1]));
+
+  // bounds ports, then pen ports
+  PlotWidget& plot=plots.plots["plot"];
+  for (int i=0; i<12; ++i)
+    plot.ports<<=addPort(Port(0,0,true));
+  addWire(Wire(sinOp->ports()[0], plot.ports[4]));
+
+  constructEquations();
+  CHECK_EQUAL(1, plot.yvars.size());
+  variables.values["a"]=1;
+  evalFlowVars(&flowVars[0], &stockVars[0]);
+  CHECK_CLOSE(sin(1.0), plot.yvars[0].value(), 1e-10);
+}
+
+// evaluating wide levels of the tape on a thread pool gives the same
+// result as serial evaluation
+TEST_FIXTURE(TestFixture,parallelEval)
+{
+  // independent integrals, each fed by the sine of itself
+  for (int i=0; i<100; i+=2)
+    {
+      operations[i]=OperationPtr(OperationType::integrate);
+      operations[i+1]=OperationPtr(OperationType::sin);
+      wires[i]=Wire(operations[i]->ports()[0], operations[i+1]->ports()[1]);
+      wires[i+1]=Wire(operations[i+1]->ports()[0], operations[i]->ports()[1]);
+    }
+  reset();
+  size_t n=stockVars.size();
+  CHECK_EQUAL(50, n);
+  for (size_t i=0; i<n; ++i) stockVars[i]=0.1*i;
+
+  CHECK(!threadPool);
+  vector<double> serial(n), parallel(n);
+  evalEquations(&serial[0], &stockVars[0]);
+
+  nThreads=4;
+  parallelThreshold=2;
+  vector<double> sv(stockVars);
+  reset();
+  CHECK(threadPool);
+  CHECK(tape.levelStart.size()>1);
+  evalEquations(&parallel[0], &sv[0]);
+  CHECK_ARRAY_EQUAL(serial, parallel, n);
+  for (size_t i=0; i<n; ++i)
+    CHECK_CLOSE(sin(0.1*i), parallel[i], 1e-10);
+}
+
 TEST_FIXTURE(TestFixture,integrals)
 {
   // First, integrate a constant
@@ -333,6 +568,765 @@ TEST_FIXTURE(TestFixture,integrals)
   CHECK_CLOSE(0.5*value*t*t, integrals[1].stock.value(), 1e-5);
 }
 
+// all the steppers should integrate t, and an implicit method needs
+// the time derivative
+TEST_FIXTURE(TestFixture,steppers)
+{
+  operations[1]=OperationPtr(OperationType::time);
+  operations[2]=OperationPtr(OperationType::integrate);
+  wires[0]=Wire(operations[1]->ports()[0], operations[2]->ports()[1]);
+  constructEquations();
+
+  double dfdt;
+  timeDerivative(&dfdt, &stockVars[0]);
+  CHECK_EQUAL(1, dfdt);
+
+  for (int s=0; s<OdeStepper::numSteppers; ++s)
+    {
+      stepper=OdeStepper::Type(s);
+      reset();
+      nSteps=10;
+      step();
+      CHECK(t>0);
+      CHECK_CLOSE(0.5*t*t, integrals[0].stock.value(), 1e-2);
+    }
+}
+
+namespace
+{
+  // integrate the constant \a value in \a m
+  void buildConstantIntegral(Minsky& m, double value)
+  {
+    LocalMinsky lm(m);
+    m.operations[1]=OperationPtr(OperationType::constant);
+    m.operations[2]=OperationPtr(OperationType::integrate);
+    m.wires[0]=Wire(m.operations[1]->ports()[0], m.operations[2]->ports()[1]);
+    dynamic_cast<Constant*>(m.operations[1].get())->value=value;
+  }
+
+  void* stepModel(void* m)
+  {
+    try
+      {
+        for (int i=0; i<100; ++i) static_cast<Minsky*>(m)->step();
+      }
+    catch (...) {}
+    return NULL;
+  }
+}
+
+// separate models may be run concurrently on separate threads
+TEST(concurrentModels)
+{
+  Minsky m1, m2;
+  buildConstantIntegral(m1, 1);
+  buildConstantIntegral(m2, 2);
+
+  pthread_t t1, t2;
+  pthread_create(&t1, NULL, stepModel, &m1);
+  pthread_create(&t2, NULL, stepModel, &m2);
+  pthread_join(t1, NULL);
+  pthread_join(t2, NULL);
+
+  CHECK(m1.t>0 && m2.t>0);
+  CHECK_CLOSE(m1.t, m1.stockVars[m1.integrals[0].stock.idx()], 1e-5);
+  CHECK_CLOSE(2*m2.t, m2.stockVars[m2.integrals[0].stock.idx()], 1e-5);
+  // the global model is untouched
+  CHECK(&minsky()!=&m1 && &minsky()!=&m2);
+}
+
+// a sweep over the integrated constant, with results independent of
+// the number of threads
+TEST_FIXTURE(TestFixture,sweep)
+{
+  buildConstantIntegral(*this, 1);
+  string name=dynamic_cast<IntOp&>(*operations[2]).getDescription();
+  sweep.addGrid(1, 0, 3, 4);
+  sweep.addOutput(name);
+  sweep.horizon=1;
+  sweep.nThreads=4;
+  runSweep();
+
+  CHECK_EQUAL(4, sweep.nRuns());
+  CHECK_EQUAL(3, sweep.columns.size());
+  for (size_t r=0; r<sweep.nRuns(); ++r)
+    {
+      CHECK_EQUAL(r, sweep.result(r,0));
+      CHECK(sweep.result(r,1)>=1);
+      CHECK_CLOSE(sweep.result(r,0)*sweep.result(r,1), sweep.result(r,2), 1e-5);
+    }
+
+  sweep.clear();
+  sweep.addNormal(1, 1, 0.1);
+  sweep.addOutput(name);
+  sweep.nSamples=5;
+  runSweep();
+  vector<double> parallel=sweep.results;
+  CHECK_EQUAL(5, sweep.nRuns());
+  sweep.nThreads=1;
+  runSweep();
+  CHECK_ARRAY_EQUAL(sweep.results, parallel, parallel.size());
+
+  // the model itself is untouched
+  CHECK_EQUAL(1, dynamic_cast<Constant&>(*operations[1]).value);
+}
+
+// a diverging run yields NaN outputs, without reporting to Tcl from
+// the worker threads
+TEST_FIXTURE(TestFixture,sweepDivergentRun)
+{
+  buildConstantIntegral(*this, 1);
+  operations[3]=OperationPtr(OperationType::sqrt);
+  wires[0]=Wire(operations[1]->ports()[0], operations[3]->ports()[1]);
+  wires[1]=Wire(operations[3]->ports()[0], operations[2]->ports()[1]);
+  string name=dynamic_cast<IntOp&>(*operations[2]).getDescription();
+  sweep.addGrid(1, -1, 1, 3);
+  sweep.addOutput(name);
+  sweep.horizon=1;
+  sweep.nThreads=3;
+  Tcl_ResetResult(interp());
+  runSweep();
+
+  CHECK_EQUAL(3, sweep.nRuns());
+  CHECK(!finite(sweep.result(0,2)));
+  CHECK_CLOSE(0, sweep.result(1,2), 1e-5);
+  CHECK_CLOSE(sweep.result(2,1), sweep.result(2,2), 1e-5);
+  CHECK_EQUAL(string(), Tcl_GetStringResult(interp()));
+}
+
+// steps are appended to the recording file, which can be read while
+// the recording is in progress
+TEST_FIXTURE(TestFixture,recorder)
+{
+  buildConstantIntegral(*this, 2);
+  string name=dynamic_cast<IntOp&>(*operations[2]).getDescription();
+  recorder.names.push_back(name);
+  recorder.chunkRows=1; // rounded up to a page
+  const char* file="recorder.dat";
+  startRecording(file);
+  nSteps=1;
+  for (int i=0; i<1000; ++i) step();
+  CHECK_EQUAL(1000, recorder.rows());
+
+  FILE* f=fopen(file,"rb");
+  CHECK(f);
+  RecordingHeader h;
+  CHECK_EQUAL(1, fread(&h, sizeof(h), 1, f));
+  CHECK_EQUAL(0, strncmp(h.magic, "MINSKYTS", 8));
+  CHECK_EQUAL(2, h.nColumns);
+  CHECK_EQUAL(1000, h.nRows);
+  CHECK(h.chunkRows>1 && h.chunkRows<1000);
+
+  // last row, which is in the second chunk
+  size_t chunk=999/h.chunkRows, row=999%h.chunkRows;
+  double tRec, xRec;
+  fseek(f, h.dataOffset+chunk*h.chunkBytes+row*sizeof(double), SEEK_SET);
+  CHECK_EQUAL(1, fread(&tRec, sizeof(double), 1, f));
+  fseek(f, h.dataOffset+chunk*h.chunkBytes+(h.chunkRows+row)*sizeof(double),
+        SEEK_SET);
+  CHECK_EQUAL(1, fread(&xRec, sizeof(double), 1, f));
+  fclose(f);
+  CHECK_EQUAL(t, tRec);
+  CHECK_CLOSE(2*t, xRec, 1e-5);
+
+  stopRecording();
+  CHECK(!recorder.recording());
+  remove(file);
+}
+
+// a restored checkpoint resumes from where it was taken
+TEST_FIXTURE(TestFixture,checkpoint)
+{
+  buildConstantIntegral(*this, 2);
+  nSteps=10;
+  step();
+  double t1=t;
+  vector<double> s1=stockVars;
+  const char* file="checkpoint.dat";
+  checkpoint(file);
+
+  step();
+  CHECK(t>t1);
+  restore(file);
+  CHECK_EQUAL(t1, t);
+  CHECK_ARRAY_EQUAL(s1, stockVars, s1.size());
+  step();
+  CHECK(t>t1);
+  CHECK_CLOSE(2*t, integrals[0].stock.value(), 1e-5);
+
+  // a different model is rejected
+  Minsky other;
+  buildConstantIntegral(other, 1);
+  {
+    LocalMinsky lm(other);
+    other.operations[3]=OperationPtr(OperationType::integrate);
+    other.wires[1]=Wire(other.operations[2]->ports()[0], 
+                        other.operations[3]->ports()[1]);
+  }
+  CHECK_THROW(other.restore(file), ecolab::error);
+  remove(file);
+}
+
+// a plot's level of detail buffers survive a checkpoint, so that
+// replotting after a restore retains the plot's history
+TEST_FIXTURE(TestFixture,checkpointPlotLOD)
+{
+  buildConstantIntegral(*this, 2);
+  PlotWidget& plot=plots.plots["plot"];
+  vector<PlotLOD>& lod=plotLOD(plot);
+  lod.resize(1);
+  for (int i=0; i<10000; ++i)
+    lod[0].add(i, sin(0.01*i));
+  vector<PlotLOD::Pt> before, after;
+  lod[0].points(before);
+  const char* file="checkpoint.dat";
+  checkpoint(file);
+
+  plot.clear();
+  restore(file);
+  CHECK_EQUAL(1, plotLOD(plot).size());
+  plotLOD(plot)[0].points(after);
+  CHECK(before==after);
+  remove(file);
+}
+
+// checkpoints are keyed by variable name, so can be restored into a
+// reloaded model, whose slots are laid out afresh
+TEST_FIXTURE(TestFixture,checkpointAfterEdit)
+{
+  buildConstantIntegral(*this, 2);
+  variables.addVariable(VariablePtr(VariableType::flow,"m"));
+  reset();
+  // "a" sorts before "m", but is allocated a later slot
+  variables.addVariable(VariablePtr(VariableType::flow,"a"));
+  markEdited();
+  nSteps=10;
+  step();
+  double t1=t, s1=integrals[0].stock.value();
+  string name=dynamic_cast<IntOp&>(*operations[2]).getDescription();
+  const char* file="checkpoint.dat", *modelFile="checkpoint.mky";
+  checkpoint(file);
+  Save(modelFile);
+
+  Minsky loaded;
+  {
+    LocalMinsky lm(loaded);
+    loaded.Load(modelFile);
+  }
+  loaded.restore(file);
+  CHECK_EQUAL(t1, loaded.t);
+  {
+    LocalMinsky lm(loaded);
+    CHECK_EQUAL(s1, loaded.variables.values[name].value());
+  }
+  remove(file);
+  remove(modelFile);
+}
+
+// a model saved in binary format loads back the same as from XML
+TEST_FIXTURE(TestFixture,binaryModel)
+{
+  buildConstantIntegral(*this, 3);
+  const char* binFile="binaryModel.mky", *xmlFile="xmlModel.mky";
+  SaveBinary(binFile);
+  Save(xmlFile);
+  CHECK(isBinaryModel(binFile));
+  CHECK(!isBinaryModel(xmlFile));
+
+  Minsky fromBinary, fromXML;
+  {
+    LocalMinsky lm(fromBinary);
+    fromBinary.Load(binFile);
+  }
+  {
+    LocalMinsky lm(fromXML);
+    fromXML.Load(xmlFile);
+  }
+  CHECK_EQUAL(fromXML.operations.size(), fromBinary.operations.size());
+  CHECK_EQUAL(fromXML.wires.size(), fromBinary.wires.size());
+  CHECK_EQUAL(fromXML.variables.size(), fromBinary.variables.size());
+  CHECK_EQUAL(operations.size(), fromBinary.operations.size());
+  CHECK_EQUAL(wires.size(), fromBinary.wires.size());
+
+  bool found=false;
+  for (Operations::const_iterator o=fromBinary.operations.begin(); 
+       o!=fromBinary.operations.end(); ++o)
+    if (Constant* c=dynamic_cast<Constant*>(o->second.get()))
+      {
+        CHECK_EQUAL(3, c->value);
+        found=true;
+      }
+  CHECK(found);
+  remove(binFile);
+  remove(xmlFile);
+}
+
+// each lane of an ensemble integrates its own constant
+TEST_FIXTURE(TestFixture,ensemble)
+{
+  operations[1]=OperationPtr(OperationType::constant);
+  operations[2]=OperationPtr(OperationType::integrate);
+  operations[3]=OperationPtr(OperationType::integrate);
+  wires[0]=Wire(operations[1]->ports()[0], operations[2]->ports()[1]);
+  wires[1]=Wire(operations[2]->ports()[0], operations[3]->ports()[1]);
+  dynamic_cast<Constant*>(operations[1].get())->value=1;
+
+  initEnsemble(5);
+  for (int k=1; k<5; ++k)
+    setEnsembleParameter(1, k, k+1);
+  ensemble.step(0.01, 100);
+  CHECK_CLOSE(1, ensemble.t, 1e-10);
+  int first=integrals[0].operation==
+    dynamic_cast<IntOp*>(operations[2].get())? 0: 1;
+  for (int k=0; k<5; ++k)
+    {
+      CHECK_CLOSE(k+1, ensemble.stock(integrals[first].stock.idx(), k), 1e-8);
+      CHECK_CLOSE(0.5*(k+1), 
+                  ensemble.stock(integrals[1-first].stock.idx(), k), 1e-8);
+    }
+  CHECK_THROW(setEnsembleParameter(2, 0, 1), ecolab::error);
+
+  // an ensemble set up after stepping continues from the current state
+  step();
+  CHECK(t>0);
+  initEnsemble(2);
+  CHECK_EQUAL(t, ensemble.t);
+  int s=integrals[first].stock.idx();
+  CHECK_EQUAL(stockVars[s], ensemble.stock(s, 1));
+}
+
+// jacobian over more stocks than are propagated in a single tangent
+// sweep, compared with finite differences
+TEST_FIXTURE(TestFixture,jacobianManyStocks)
+{
+  // chain of integrals, each fed by the sine of the previous one
+  operations[0]=OperationPtr(OperationType::constant);
+  int w=0, lastOut=operations[0]->ports()[0];
+  for (int i=1; i<=2*(EvalTape::derivWidth+2); i+=2)
+    {
+      operations[i]=OperationPtr(OperationType::integrate);
+      operations[i+1]=OperationPtr(OperationType::sin);
+      wires[w++]=Wire(lastOut, operations[i]->ports()[1]);
+      wires[w++]=Wire(operations[i]->ports()[0], operations[i+1]->ports()[1]);
+      lastOut=operations[i+1]->ports()[0];
+    }
+  dynamic_cast<Constant*>(operations[0].get())->value=1;
+  constructEquations();
+
+  size_t n=stockVars.size();
+  CHECK(n>EvalTape::derivWidth);
+  for (size_t i=0; i<n; ++i) stockVars[i]=0.1*(i+1);
+
+  vector<double> j(n*n);
+  Matrix jac(n,&j[0]);
+  jacobian(jac,&stockVars[0]);
+
+  vector<double> f0(n), f1(n), s(stockVars);
+  evalEquations(&f0[0], &s[0]);
+  const double h=1e-6;
+  for (size_t col=0; col<n; ++col)
+    {
+      s[col]+=h;
+      evalEquations(&f1[0], &s[0]);
+      s[col]-=h;
+      for (size_t row=0; row<n; ++row)
+        CHECK_CLOSE((f1[row]-f0[row])/h, jac(row,col), 1e-5);
+    }
+
+  // each stock depends only on its predecessor, so the sparse version
+  // needs a single colour
+  CHECK_EQUAL(n, jacobianPattern.n);
+  CHECK_EQUAL(n-1, jacobianPattern.col.size());
+  CHECK_EQUAL(1, jacobianPattern.nColours);
+  SparseMatrix sjac;
+  sparseJacobian(sjac, &stockVars[0]);
+  CHECK_EQUAL(n-1, sjac.nonZeros());
+  for (size_t row=0; row<n; ++row)
+    for (size_t col=0; col<n; ++col)
+      CHECK_EQUAL(jac(row,col), sjac(row,col));
+}
+
+// each level of adds has two paths through it, which should not
+// make the cost of ordering the operations exponential
+TEST_FIXTURE(TestFixture,deepDiamond)
+{
+  const int depth=60;
+  operations[0]=OperationPtr(OperationType::constant);
+  dynamic_cast<Constant*>(operations[0].get())->value=1;
+  int w=0;
+  for (int i=1; i<=depth; ++i)
+    {
+      operations[i]=OperationPtr(OperationType::add);
+      wires[w++]=Wire(operations[i-1]->ports()[0], operations[i]->ports()[1]);
+      wires[w++]=Wire(operations[i-1]->ports()[0], operations[i]->ports()[2]);
+    }
+  int out=variables.addVariable(VariablePtr(VariableType::flow,"out"));
+  wires[w++]=Wire(operations[depth]->ports()[0], variables[out]->inPort());
+  nSteps=1;
+  step();
+  double expected=1;
+  for (int i=0; i<depth; ++i) expected*=2;
+  CHECK_EQUAL(expected, variables.values["out"].value());
+}
+
+// variables keep their slots in the value vectors when the model is
+// edited, and new variables reuse the slots of deleted ones
+TEST_FIXTURE(TestFixture,stableSlots)
+{
+  buildConstantIntegral(*this, 1);
+  variables.addVariable(VariablePtr(VariableType::flow,"m"));
+  reset();
+  int m=variables.values["m"].idx();
+  CHECK(m>=0);
+
+  // "a" sorts before "m"
+  variables.addVariable(VariablePtr(VariableType::flow,"a"));
+  reset();
+  CHECK_EQUAL(m, variables.values["m"].idx());
+  int a=variables.values["a"].idx();
+  CHECK(a>=0 && a!=m);
+
+  variables.removeVariable("a");
+  variables.addVariable(VariablePtr(VariableType::flow,"b"));
+  reset();
+  CHECK_EQUAL(m, variables.values["m"].idx());
+  CHECK_EQUAL(a, variables.values["b"].idx());
+}
+
+// the wires attached to each port track additions and deletions,
+// whether made through the PortManager or directly
+TEST_FIXTURE(TestFixture,wiresAttachedToPort)
+{
+  operations[0]=OperationPtr(OperationType::constant);
+  operations[1]=OperationPtr(OperationType::add);
+  operations[2]=OperationPtr(OperationType::exp);
+  int out=operations[0]->ports()[0];
+  int w1=PortManager::addWire(Wire(out, operations[1]->ports()[1]));
+  int w2=PortManager::addWire(Wire(out, operations[1]->ports()[2]));
+  CHECK_EQUAL(2, WiresAttachedToPort(out).size());
+  CHECK_EQUAL(w1, WiresAttachedToPort(operations[1]->ports()[1])[0]);
+
+  // directly inserted wires are picked up
+  wires[w2+1]=Wire(out, operations[2]->ports()[1]);
+  CHECK_EQUAL(3, WiresAttachedToPort(out).size());
+  CHECK_EQUAL(w2+1, WiresAttachedToPort(operations[2]->ports()[1])[0]);
+
+  PortManager::deleteWire(w1);
+  CHECK_EQUAL(2, WiresAttachedToPort(out).size());
+  CHECK(WiresAttachedToPort(operations[1]->ports()[1]).empty());
+
+  // as are end points changed directly
+  wires[w2].to=operations[1]->ports()[1];
+  wiresChanged();
+  CHECK(WiresAttachedToPort(operations[1]->ports()[2]).empty());
+  CHECK_EQUAL(w2, WiresAttachedToPort(operations[1]->ports()[1])[0]);
+
+  delPort(out);
+  CHECK(WiresAttachedToPort(out).empty());
+  CHECK(wires.empty());
+}
+
+// closest port queries follow ports as they are added, moved and
+// deleted
+TEST_FIXTURE(TestFixture,closestPort)
+{
+  int in1=addPort(Port(0,0,true)), in2=addPort(Port(100,0,true));
+  int out=addPort(Port(10,10,false));
+  CHECK_EQUAL(in1, ClosestInPort(20,0));
+  CHECK_EQUAL(out, ClosestOutPort(90,0));
+  CHECK_EQUAL(out, ClosestPort(12,12));
+
+  movePortTo(in2, 15, 0);
+  CHECK_EQUAL(in2, ClosestInPort(20,0));
+  delPort(in2);
+  CHECK_EQUAL(in1, ClosestInPort(20,0));
+
+  // directly inserted ports are found too
+  ports[in2]=Port(30,0,true);
+  CHECK_EQUAL(in2, ClosestInPort(20,0));
+}
+
+// replacing a port, wire or operation in place leaves the size of its
+// map unchanged, but must still be reflected in the indices
+TEST_FIXTURE(TestFixture,sameSizeReplacement)
+{
+  operations[0]=OperationPtr(OperationType::constant);
+  operations[1]=OperationPtr(OperationType::exp);
+  operations[2]=OperationPtr(OperationType::exp);
+  int out=operations[0]->ports()[0];
+  int in1=operations[1]->ports()[1], in2=operations[2]->ports()[1];
+  int w=PortManager::addWire(Wire(out, in1));
+  CHECK_EQUAL(w, WiresAttachedToPort(in1)[0]);
+
+  // as by wire.set from TCL
+  wire.key=w;
+  static_cast<Wire&>(wire)=Wire(out, in2);
+  wire.set(TCL_args());
+  CHECK(WiresAttachedToPort(in1).empty());
+  CHECK_EQUAL(w, WiresAttachedToPort(in2)[0]);
+
+  // as by port.set from TCL
+  int p=addPort(Port(1000,1000,true)), q=addPort(Port(1100,1000,true));
+  CHECK_EQUAL(q, ClosestInPort(1090,1000));
+  port.key=p;
+  static_cast<Port&>(port)=Port(1095,1000,true);
+  port.set(TCL_args());
+  CHECK_EQUAL(p, ClosestInPort(1090,1000));
+
+  // an integral deleted and another added in its place
+  int i1=AddOperation("integrate");
+  int v1=dynamic_cast<IntOp&>(*operations[i1]).intVarID();
+  CHECK_EQUAL(i1, variables.integralOwner(v1));
+  DeleteOperation(i1);
+  int i2=AddOperation("integrate");
+  int v2=dynamic_cast<IntOp&>(*operations[i2]).intVarID();
+  CHECK_EQUAL(i2, variables.integralOwner(v2));
+}
+
+// the canvas journal reports items created, modified and deleted
+// since it was last drained
+TEST_FIXTURE(TestFixture,canvasChanges)
+{
+  int v=variables.newVariable("foo");
+  string id=str(v);
+  CHECK_EQUAL("created var "+id+" ", canvasChanges());
+  CHECK_EQUAL("", canvasChanges());
+  variables[v]->MoveTo(10,10);
+  CHECK_EQUAL("modified var "+id+" ", canvasChanges());
+  variables.erase(v);
+  CHECK_EQUAL("deleted var "+id+" ", canvasChanges());
+
+  // an item reported without any visible change is not redrawn
+  int a=variables.newVariable("a"), b=variables.newVariable("b");
+  canvasChanges();
+  variables[a]->MoveTo(variables[a]->x(), variables[a]->y());
+  CHECK_EQUAL("", canvasChanges());
+
+  // wires follow the ports they attach to
+  addWire(Wire(variables[a]->outPort(), variables[b]->inPort()));
+  string w=str(wires.rbegin()->first);
+  CHECK_EQUAL("created wire "+w+" ", canvasChanges());
+  variables[a]->MoveTo(50,50);
+  CHECK_EQUAL("modified var "+str(a)+" modified wire "+w+" ", 
+              canvasChanges());
+
+  // values are compared in double precision
+  int o=AddOperation("constant");
+  Constant& c=dynamic_cast<Constant&>(*operations[o]);
+  c.value=1;
+  canvasChanges();
+  c.value=1+1e-12;
+  touched(static_cast<const OperationBase*>(&c));
+  CHECK_EQUAL("modified op "+str(o)+" ", canvasChanges());
+
+  // items inserted without being reported change the count of items
+  operations[o+1]=OperationPtr(OperationType::time);
+  CHECK_EQUAL("created op "+str(o+1)+" ", canvasChanges());
+}
+
+// zooming in and back out again returns items to where they were
+TEST_FIXTURE(TestFixture,zoomRoundTrip)
+{
+  int v=variables.newVariable("foo"), o=AddOperation("time");
+  variables[v]->MoveTo(123.4,567.8);
+  operations[o]->MoveTo(-345.6,78.9);
+  for (int i=0; i<50; ++i) Zoom(10,20,1.1);
+  for (int i=0; i<50; ++i) Zoom(10,20,1/1.1);
+  CHECK_CLOSE(1, zoomFactor(), 1e-12);
+  CHECK_CLOSE(1, variables[v]->zoomFactor, 1e-12);
+  CHECK_CLOSE(1, operations[o]->zoomFactor, 1e-12);
+  CHECK_CLOSE(123.4, variables[v]->x(), 1e-4);
+  CHECK_CLOSE(567.8, variables[v]->y(), 1e-4);
+  CHECK_CLOSE(-345.6, operations[o]->x(), 1e-4);
+  CHECK_CLOSE(78.9, operations[o]->y(), 1e-4);
+}
+
+// zooming a hidden wire leaves it, and the group map, untouched
+TEST_FIXTURE(TestFixture,zoomHiddenWire)
+{
+  Wire w(0, 0, ecolab::array<float>(), false);
+  w.group=99;
+  w.zoom(10, 20, 2);
+  CHECK_EQUAL(0, groupItems.count(99));
+}
+
+// plot level of detail keeps the envelope of a long time series
+// within a bounded number of points
+TEST(plotLOD)
+{
+  PlotLOD lod;
+  double lo=1e10, hi=-1e10;
+  for (int i=0; i<100000; ++i)
+    {
+      double y=sin(0.01*i);
+      lo=min(lo,y); hi=max(hi,y);
+      lod.add(i,y);
+    }
+  vector<PlotLOD::Pt> pts;
+  lod.points(pts);
+  CHECK(pts.size()<=2*PlotLOD::defaultColumns);
+  double plo=1e10, phi=-1e10;
+  for (size_t i=0; i<pts.size(); ++i)
+    {
+      plo=min(plo,pts[i].y); phi=max(phi,pts[i].y);
+      if (i>0) CHECK(pts[i-1].x<=pts[i].x);
+    }
+  CHECK_EQUAL(lo, plo);
+  CHECK_EQUAL(hi, phi);
+
+  // x going backwards (eg a phase plot) retains every point
+  lod.clear();
+  for (int i=0; i<100; ++i)
+    lod.add(cos(0.1*i), sin(0.1*i));
+  lod.points(pts);
+  CHECK_EQUAL(100u, pts.size());
+
+  // and remains bounded over a long run, keeping the latest point
+  lod.maxColumns=16;
+  for (int i=100; i<100000; ++i)
+    lod.add(cos(0.1*i), sin(0.1*i));
+  lod.points(pts);
+  CHECK(pts.size()<=2*lod.maxColumns+1);
+  CHECK(pts.back()==PlotLOD::Pt(cos(0.1*99999), sin(0.1*99999)));
+  CHECK_CLOSE(-1, lod.lower().x, 1e-3);
+  CHECK_CLOSE(1, lod.upper().y, 1e-3);
+
+  // as does a time series binned into fewer columns
+  lod.clear();
+  CHECK(lod.empty());
+  for (int i=0; i<1000; ++i)
+    lod.add(i, i%7);
+  lod.points(pts);
+  CHECK(pts.size()<=2*lod.maxColumns);
+  CHECK_EQUAL(999, lod.upper().x);
+  CHECK_EQUAL(6, lod.upper().y);
+}
+
+// a plot's bounds cover every point added, including those hidden
+// within a level of detail column
+TEST_FIXTURE(TestFixture,plotExtent)
+{
+  buildConstantIntegral(*this, 1);
+  constructEquations();
+  step();
+  PlotWidget& plot=plots.plots["plot"];
+  plot.resolution=16;
+  string intVar=
+    variables[dynamic_cast<IntOp&>(*operations[2]).intVarID()]->Name();
+  plot.connectVar(variables.getVariableValue(intVar), 4);
+  for (int i=0; i<100; ++i) 
+    {
+      step();
+      CHECK(plot.maxx>=t);
+      CHECK(plot.maxy>=variables.getVariableValue(intVar).value());
+    }
+  CHECK(plotLOD(plot)[0].maxColumns==16);
+}
+
+// the scene index follows items as they are added, moved and deleted
+TEST_FIXTURE(TestFixture,sceneIndex)
+{
+  int v=variables.newVariable("foo"), o=AddOperation("time");
+  variables[v]->MoveTo(100,100);
+  operations[o]->MoveTo(300,100);
+  Rectangle lasso(Point(50,50), Point(150,150)),
+    at300(Point(299,99), Point(301,101)), at600(Point(599,199), Point(601,201));
+  SceneIndex::Items items=sceneIndex.Intersecting(*this, lasso);
+  CHECK_EQUAL(1, items.size());
+  CHECK(items[0]==SceneIndex::Item(SceneIndex::Item::variable, v));
+  items=sceneIndex.Intersecting(*this, at300);
+  CHECK_EQUAL(1, items.size());
+  CHECK(items[0]==SceneIndex::Item(SceneIndex::Item::operation, o));
+
+  variables[v]->MoveTo(300,100);
+  CHECK(sceneIndex.Intersecting(*this, lasso).empty());
+  CHECK_EQUAL(2, sceneIndex.Intersecting(*this, at300).size());
+
+  DeleteOperation(o);
+  items=sceneIndex.Intersecting(*this, at300);
+  CHECK_EQUAL(1, items.size());
+  CHECK(items[0]==SceneIndex::Item(SceneIndex::Item::variable, v));
+
+  // zooming moves every item
+  Zoom(0,0,2);
+  CHECK(sceneIndex.Intersecting(*this, at300).empty());
+  CHECK_EQUAL(1, sceneIndex.Intersecting(*this, at600).size());
+
+  // items inserted directly are found by the count of items changing
+  operations[o]=OperationPtr(OperationType::time);
+  operations[o]->MoveTo(100,100);
+  items=sceneIndex.Intersecting(*this, lasso);
+  CHECK_EQUAL(1, items.size());
+  CHECK(items[0]==SceneIndex::Item(SceneIndex::Item::operation, o));
+}
+
+// the instances of each variable name follow additions, renames and
+// deletions
+TEST_FIXTURE(TestFixture,variableInstances)
+{
+  int a=variables.newVariable("x"), b=variables.newVariable("x"), 
+    c=variables.newVariable("y");
+  CHECK_EQUAL(2, variables.InstancesOf("x").size());
+  CHECK(variables.InstancesOf("x").count(a));
+  variables[b]->Name("y");
+  CHECK_EQUAL(1, variables.InstancesOf("x").size());
+  CHECK_EQUAL(2, variables.InstancesOf("y").size());
+
+  // the value remains while there are other instances
+  variables.erase(c);
+  CHECK_EQUAL(1, variables.InstancesOf("y").size());
+  CHECK(variables.values.count("y"));
+  variables.erase(b);
+  CHECK(variables.InstancesOf("y").empty());
+  CHECK(!variables.values.count("y"));
+  variables.removeVariable("x");
+  CHECK(variables.InstancesOf("x").empty());
+  CHECK(!variables.count(a));
+
+  // integral variables are not erased while owned by an integral
+  operations[0]=OperationPtr(OperationType::integrate);
+  int iv=dynamic_cast<IntOp&>(*operations[0]).intVarID();
+  CHECK_EQUAL(0, variables.integralOwner(iv));
+  variables.erase(iv);
+  CHECK(variables.count(iv));
+}
+
+// once warmed up, integration steps should not touch the heap
+TEST_FIXTURE(TestFixture,stepDoesNotAllocate)
+{
+  operations[1]=OperationPtr(OperationType::constant);
+  operations[2]=OperationPtr(OperationType::integrate);
+  operations[3]=OperationPtr(OperationType::sin);
+  operations[4]=OperationPtr(OperationType::integrate);
+  wires[0]=Wire(operations[1]->ports()[0], operations[2]->ports()[1]);
+  wires[1]=Wire(operations[2]->ports()[0], operations[3]->ports()[1]);
+  wires[2]=Wire(operations[3]->ports()[0], operations[4]->ports()[1]);
+  dynamic_cast<Constant*>(operations[1].get())->value=1;
+  // a plot of a constant valued variable against time
+  int c=variables.newVariable("c");
+  wires[3]=Wire(operations[1]->ports()[0], variables[c]->inPort());
+
+  constructEquations();
+  nSteps=10;
+  step(); // allocates the ODE driver and scratch buffers
+  PlotWidget& plot=plots.plots["plot"];
+  plot.connectVar(variables.getVariableValue("c"), 4);
+  // each step appends a point to the plot, whose own data grows
+  // geometrically, so measure between two of its reallocations
+  for (int i=0; i<40; ++i) step();
+
+  size_t allocs=allocationCount();
+  for (int i=0; i<10; ++i) step();
+  CHECK_EQUAL(allocs, allocationCount());
+
+  vector<double> j(stockVars.size()*stockVars.size());
+  Matrix jac(stockVars.size(),&j[0]);
+  jacobian(jac, &stockVars[0]);
+  allocs=allocationCount();
+  jacobian(jac, &stockVars[0]);
+  CHECK_EQUAL(allocs, allocationCount());
+}
+
 /*
   check that cyclic networks throw an exception
 
@@ -0,0 +1,112 @@
+/*
+  @copyright Steve Keen 2013
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "threadPool.h"
+#include <algorithm>
+
+namespace minsky
+{
+  ThreadPool::ThreadPool(unsigned nThreads): 
+    task(NULL), n(0), chunk(1), next(0), generation(0), busy(0), quit(false)
+  {
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&startCond, NULL);
+    pthread_cond_init(&doneCond, NULL);
+    for (unsigned i=1; i<nThreads; ++i)
+      {
+        pthread_t t;
+        if (pthread_create(&t, NULL, worker, this))
+          break; // carry on with the threads we have
+        workers.push_back(t);
+      }
+  }
+
+  ThreadPool::~ThreadPool()
+  {
+    pthread_mutex_lock(&mutex);
+    quit=true;
+    pthread_cond_broadcast(&startCond);
+    pthread_mutex_unlock(&mutex);
+    for (size_t i=0; i<workers.size(); ++i)
+      pthread_join(workers[i], NULL);
+    pthread_cond_destroy(&doneCond);
+    pthread_cond_destroy(&startCond);
+    pthread_mutex_destroy(&mutex);
+  }
+
+  void* ThreadPool::worker(void* p)
+  {
+    ThreadPool& pool=*static_cast<ThreadPool*>(p);
+    unsigned seen=0;
+    for (;;)
+      {
+        pthread_mutex_lock(&pool.mutex);
+        while (pool.generation==seen && !pool.quit)
+          pthread_cond_wait(&pool.startCond, &pool.mutex);
+        if (pool.quit)
+          {
+            pthread_mutex_unlock(&pool.mutex);
+            return NULL;
+          }
+        seen=pool.generation;
+        pthread_mutex_unlock(&pool.mutex);
+
+        pool.runChunks();
+
+        pthread_mutex_lock(&pool.mutex);
+        if (--pool.busy==0)
+          pthread_cond_signal(&pool.doneCond);
+        pthread_mutex_unlock(&pool.mutex);
+      }
+  }
+
+  void ThreadPool::runChunks()
+  {
+    for (;;)
+      {
+        size_t begin=__sync_fetch_and_add(&next, chunk);
+        if (begin>=n) return;
+        (*task)(begin, std::min(begin+chunk, n));
+      }
+  }
+
+  void ThreadPool::parallelFor(size_t n, size_t chunk, Task& task)
+  {
+    if (workers.empty() || n<=chunk)
+      {
+        task(0, n);
+        return;
+      }
+    pthread_mutex_lock(&mutex);
+    this->task=&task;
+    this->n=n;
+    this->chunk=chunk>0? chunk: 1;
+    next=0;
+    busy=workers.size();
+    ++generation;
+    pthread_cond_broadcast(&startCond);
+    pthread_mutex_unlock(&mutex);
+
+    runChunks();
+
+    pthread_mutex_lock(&mutex);
+    while (busy>0)
+      pthread_cond_wait(&doneCond, &mutex);
+    pthread_mutex_unlock(&mutex);
+  }
+}
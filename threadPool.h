@@ -0,0 +1,74 @@
+/*
+  @copyright Steve Keen 2013
+  @author Russell Standish
+  This file is part of Minsky.
+
+  Minsky is free software: you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Minsky is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <pthread.h>
+#include <vector>
+
+namespace minsky
+{
+  /**
+     A persistent pool of worker threads for data parallel loops. The
+     calling thread joins in the work, and workers claim chunks of the
+     index range dynamically, so that uneven chunks balance out.
+  */
+  class ThreadPool
+  {
+  public:
+    /// work to be done over an index range
+    struct Task
+    {
+      virtual ~Task() {}
+      /// process indices [begin,end)
+      virtual void operator()(size_t begin, size_t end)=0;
+    };
+
+    /// create a pool with \a nThreads threads in total, including the
+    /// calling thread
+    ThreadPool(unsigned nThreads);
+    ~ThreadPool();
+    /// number of threads, including the calling thread
+    unsigned size() const {return workers.size()+1;}
+
+    /// run \a task over [0,\a n) in chunks of \a chunk, returning
+    /// once all chunks are complete. Not reentrant, and \a task must
+    /// not throw.
+    void parallelFor(size_t n, size_t chunk, Task& task);
+
+  private:
+    std::vector<pthread_t> workers;
+    pthread_mutex_t mutex;
+    pthread_cond_t startCond, doneCond;
+    Task* task;
+    size_t n, chunk;
+    size_t next; ///< start of the next unclaimed chunk
+    unsigned generation; ///< incremented for each parallelFor
+    unsigned busy; ///< number of workers yet to finish
+    bool quit;
+
+    static void* worker(void*);
+    void runChunks();
+    // not copyable
+    ThreadPool(const ThreadPool&);
+    void operator=(const ThreadPool&);
+  };
+}
+
+#endif
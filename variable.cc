@@ -76,6 +76,11 @@ string VariableBase::Name(const std::string& name)
   // ensure an associated variableValue exists
   if (variableManager().values.count(name)==0)
     variableManager().values.insert(make_pair(name,VariableValue(type())));
+  if (name!=m_name && variableManager().getVariableIDFromPort(outPort())>=0)
+    {
+      variableManager().nameChanged();
+      minsky::minsky().touched(this);
+    }
   return m_name=name;
 }
 
@@ -134,6 +139,7 @@ void VariableBase::move(float dx, float dy)
 {
   m_x+=dx; 
   m_y+=dy;
+  minsky::minsky().touched(this);
   if (m_outPort!=-1)
     portManager().movePort(m_outPort, dx, dy);
   if (m_inPort!=-1)
@@ -152,7 +158,7 @@ array<int> VariableBase::ports() const
 }
 
 
-void VariableBase::zoom(float xOrigin, float yOrigin,float factor)
+void VariableBase::zoom(float xOrigin, float yOrigin,double factor)
 {
   if (visible)
     {
@@ -167,6 +173,13 @@ void VariableBase::zoom(float xOrigin, float yOrigin,float factor)
           m_y*=factor;
         }
       zoomFactor*=factor;
+      minsky::minsky().touched(this);
     }
 }
 
+void VariableBase::setZoom(double factor)
+{
+  zoomFactor=factor;
+  minsky::minsky().touched(this);
+}
+
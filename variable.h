@@ -53,7 +53,7 @@ struct VariableBaseAttributes: public VariableType
   // to implement integration
 
   float m_x, m_y; ///< position in canvas
-  float zoomFactor;
+  double zoomFactor;
   double rotation; /// rotation if icon, in degrees
   int group;
   
@@ -108,8 +108,8 @@ public:
 
   /// zoom by \a factor, scaling all widget's coordinates, using (\a
   /// xOrigin, \a yOrigin) as the origin of the zoom transformation
-  void zoom(float xOrigin, float yOrigin,float factor);
-  void setZoom(float factor) {zoomFactor=factor;}
+  void zoom(float xOrigin, float yOrigin,double factor);
+  void setZoom(double factor);
 
 
   double Init() const; /// < return initial value for this variable
@@ -44,7 +44,15 @@ int VariableManager::addVariable(const VariablePtr& var, int id)
                          all(var->ports() != (*this)[id]->ports())))
       return -1;
   if (id==-1)  id=empty()? 0: rbegin()->first+1;
-  insert(value_type(id,var));
+  bool indexCurrent=instancesIndexed.current(size());
+  if (insert(value_type(id,var)).second && indexCurrent)
+    {
+      instances[var->Name()].insert(id);
+      instancesIndexed.update(size());
+    }
+  else
+    instancesIndexed.invalidate();
+  minsky().touched(SceneIndex::Item(SceneIndex::Item::variable, id));
   if (var->lhs()) portToVariable[var->inPort()]=id;
   portToVariable[var->outPort()]=id;
   if (!values.count(var->Name()) && !var->Name().empty())
@@ -74,7 +82,71 @@ void VariableManager::erase(Variables::iterator it)
 {
   portToVariable.erase(it->second->outPort());
   if (it->second->lhs()) portToVariable.erase(it->second->inPort());
+  bool indexCurrent=instancesIndexed.current(size());
+  if (indexCurrent)
+    {
+      map<string, Instances>::iterator i=instances.find(it->second->Name());
+      if (i!=instances.end())
+        {
+          i->second.erase(it->first);
+          if (i->second.empty()) instances.erase(i);
+        }
+    }
+  minsky().touched
+    (SceneIndex::Item(SceneIndex::Item::variable, it->first));
   Variables::erase(it);
+  if (indexCurrent)
+    instancesIndexed.update(size());
+}
+
+const map<string, VariableManager::Instances>& 
+VariableManager::instanceIndex() const
+{
+  if (!instancesIndexed.current(size()))
+    {
+      instances.clear();
+      for (const_iterator i=begin(); i!=end(); ++i)
+        instances[i->second->Name()].insert(i->first);
+      instancesIndexed.update(size());
+    }
+  return instances;
+}
+
+const VariableManager::Instances& 
+VariableManager::InstancesOf(const string& name) const
+{
+  static const Instances none;
+  map<string, Instances>::const_iterator i=instanceIndex().find(name);
+  return i==instances.end()? none: i->second;
+}
+
+int VariableManager::integralOwner(int var) const
+{
+  const Operations& operations=minsky().operations;
+  bool rebuild=!integralOwnersIndexed.current(operations.size());
+  for (;;)
+    {
+      if (rebuild)
+        {
+          integralOwners.clear();
+          for (Operations::const_iterator o=operations.begin();
+               o!=operations.end(); ++o)
+            if (const IntOp* itg=dynamic_cast<IntOp*>(o->second.get()))
+              if (itg->intVarID()>=0)
+                integralOwners[itg->intVarID()]=o->first;
+          integralOwnersIndexed.update(operations.size());
+        }
+      map<int,int>::const_iterator i=integralOwners.find(var);
+      if (i==integralOwners.end()) return -1;
+      // check the entry against the operation, in case it is stale
+      Operations::const_iterator o=operations.find(i->second);
+      if (o!=operations.end())
+        if (const IntOp* itg=dynamic_cast<IntOp*>(o->second.get()))
+          if (itg->intVarID()==var)
+            return i->second;
+      if (rebuild) return -1;
+      rebuild=true;
+    }
 }
 
 void VariableManager::eraseGodleyVariables(const vector<VariablePtr>& varsToKeep)
@@ -103,20 +175,12 @@ void VariableManager::erase(int i)
     {
       // see if this is an integral variable, attached to an integral,
       // and do not remove variable if true
-      if (it->second->type()==VariableType::integral)
-        for (Operations::const_iterator o=minsky().operations.begin();
-             o!=minsky().operations.end(); ++o)
-          if (const IntOp* itg=dynamic_cast<IntOp*>(o->second.get()))
-            if (itg->intVarID()==i)
-              return; 
+      if (it->second->type()==VariableType::integral && integralOwner(i)>=0)
+        return; 
 
       // see if any other instance of this variable exists
-      iterator j;
-      for (j=begin(); j!=end(); ++j)
-        if (j->second->Name() == it->second->Name() && 
-            j->second->outPort()!=it->second->outPort())
-          break;
-      if (j==end()) // didn't find any others
+      const Instances& others=InstancesOf(it->second->Name());
+      if (others.size()<2) // didn't find any others
         values.erase(it->second->Name());
       portManager().delPort(it->second->outPort());
       if (it->second->lhs()) portManager().delPort(it->second->inPort());
@@ -134,13 +198,18 @@ void VariableManager::erase(const VariablePtr& v)
 int VariableManager::wireToVariable(const string& name) const
 {
   if (!InputWired(name)) return -1;
-  for (const_iterator i=begin(); i!=end(); ++i)
-    if (i->second->inPort()>-1 && i->second->Name()==name)
-      {
-        array<int> wires=portManager().WiresAttachedToPort(i->second->inPort());
-        if (wires.size()>0) 
-          return wires[0];
-      }
+  const Instances& ids=InstancesOf(name);
+  for (Instances::const_iterator id=ids.begin(); id!=ids.end(); ++id)
+    {
+      const VariablePtr& v=find(*id)->second;
+      if (v->inPort()>-1)
+        {
+          const PortManager::WireIds& wires=
+            portManager().WiresAttachedToPort(v->inPort());
+          if (wires.size()>0) 
+            return wires[0];
+        }
+    }
   return -1;
 }
 
@@ -158,20 +227,28 @@ bool VariableManager::noMultipleWiredInputs() const
 array<int> VariableManager::wiresFromVariable(const string& name) const
 {
   array<int> wires;
-  for (const_iterator i=begin(); i!=end(); ++i)
-    if (i->second->outPort()>-1 && i->second->Name()==name)
-      wires<<=portManager().WiresAttachedToPort(i->second->outPort());
+  const Instances& ids=InstancesOf(name);
+  for (Instances::const_iterator id=ids.begin(); id!=ids.end(); ++id)
+    {
+      const VariablePtr& v=find(*id)->second;
+      if (v->outPort()>-1)
+        {
+          const PortManager::WireIds& w=
+            portManager().WiresAttachedToPort(v->outPort());
+          for (size_t j=0; j<w.size(); ++j)
+            wires<<=w[j];
+        }
+    }
   return wires;
 }
 
 
 void VariableManager::removeVariable(string name)
 {
-  for (Variables::iterator it=Variables::begin(); it!=Variables::end(); )
-    if (it->second->Name()==name)
-      erase(it++);
-    else
-      ++it;
+  // copied, as erase modifies the index
+  Instances ids=InstancesOf(name);
+  for (Instances::const_iterator id=ids.begin(); id!=ids.end(); ++id)
+    erase(Variables::find(*id));
   values.erase(name);
 }     
 
@@ -225,11 +302,49 @@ VariablePtr VariableManager::getVariableFromPort(int port) const
 
 void VariableManager::reset()
 {
-  // reallocate all variables
-  ValueVector::stockVars.clear();
-  ValueVector::flowVars.clear();
+  // variables keep the slot allocated by a previous reset, so that
+  // the layout of the value vectors is stable across edits. New
+  // variables fill slots freed by deleted ones before extending the
+  // vectors.
+  vector<bool> stockUsed, flowUsed;
+  vector<VariableValue*> unallocated;
   for (VariableValues::iterator v=values.begin(); v!=values.end(); ++v)
-    v->second.allocValue();
+    {
+      VariableValue& val=v->second;
+      if (val.type()==VariableBase::undefined) 
+        {
+          val.m_idx=-1;
+          continue;
+        }
+      vector<bool>& used=val.lhs()? flowUsed: stockUsed;
+      if (val.m_idx>=0)
+        {
+          if (used.size()<=size_t(val.m_idx)) used.resize(val.m_idx+1);
+          if (!used[val.m_idx])
+            {
+              used[val.m_idx]=true;
+              continue;
+            }
+        }
+      unallocated.push_back(&val);
+    }
+
+  size_t nextStock=0, nextFlow=0;
+  for (size_t i=0; i<unallocated.size(); ++i)
+    {
+      VariableValue& val=*unallocated[i];
+      vector<bool>& used=val.lhs()? flowUsed: stockUsed;
+      size_t& next=val.lhs()? nextFlow: nextStock;
+      while (next<used.size() && used[next]) ++next;
+      if (next==used.size()) used.push_back(true);
+      else used[next]=true;
+      val.m_idx=next;
+    }
+
+  valueVector().stockVars.assign(stockUsed.size(), 0);
+  valueVector().flowVars.assign(flowUsed.size(), 0);
+  for (VariableValues::iterator v=values.begin(); v!=values.end(); ++v)
+    v->second.reset();
 }
 
 void VariableManager::makeConsistent()
@@ -244,6 +359,9 @@ void VariableManager::makeConsistent()
     else
       values.erase(i++);
 
+  instancesIndexed.invalidate();
+  integralOwnersIndexed.invalidate();
+
   // regenerate portToVariable
   portToVariable.clear();
   for (Variables::iterator i=Variables::begin(); i!=Variables::end(); ++i)
@@ -268,6 +386,8 @@ void VariableManager::makeConsistent()
 void VariableManager::clear()
 {
   Variables::clear();
+  instancesIndexed.invalidate();
+  integralOwnersIndexed.invalidate();
   wiredVariables.clear();
   portToVariable.clear();
   values.clear();
@@ -21,6 +21,7 @@
 
 #include "variable.h"
 #include "variableValue.h"
+#include "indexState.h"
 
 #include <map>
 #include <set>
@@ -47,6 +48,7 @@ namespace minsky
     typedef std::map<int, int> PortMap; 
     typedef std::set<string> WiredVariables;
     typedef std::map<string, VariableValue> VariableValues;
+    typedef std::set<int> Instances;
   
   private:
     WiredVariables wiredVariables; /// variables whose input port is wired
@@ -54,6 +56,16 @@ namespace minsky
   
     VariableValue undefined;
 
+    /// ids of the variables of each name, maintained by addVariable
+    /// and erase, and rebuilt after nameChanged()
+    mutable std::map<string, Instances> instances;
+    mutable IndexState instancesIndexed;
+    /// operation id of the integral owning each integral variable,
+    /// rebuilt after integralsChanged()
+    mutable std::map<int, int> integralOwners;
+    mutable IndexState integralOwnersIndexed;
+    const std::map<string, Instances>& instanceIndex() const;
+
     void erase(Variables::iterator it);
   public:
     VariableValues values; 
@@ -93,6 +105,18 @@ namespace minsky
     /// returns a list of wires emanating from the variable
     array_ns::array<int> wiresFromVariable(const string& name) const;
 
+    /// ids of the variables called \a name. The returned set is
+    /// invalidated by adding, removing or renaming variables.
+    const Instances& InstancesOf(const string& name) const;
+    /// id of the integral operation whose integral variable is \a
+    /// var, or -1 if none
+    int integralOwner(int var) const;
+    /// must be called when a managed variable is renamed or replaced
+    void nameChanged() {instancesIndexed.invalidate();}
+    /// must be called when operations are added, removed or
+    /// replaced, or the integral variable of an IntOp changes
+    void integralsChanged() {integralOwnersIndexed.invalidate();}
+
     /// TCL helper to check if a variable already exists by the same name
     bool exists(TCL_args args) {return values.count(args);}
     /// remove all instances of variable \a name
@@ -140,7 +164,8 @@ namespace minsky
       return r;
     }
 
-    /// reallocates variables in ValueVector, and set value back to init
+    /// allocates variables in ValueVector, and set value back to
+    /// init. Variables that already have a slot keep it.
     void reset();
 
     /// scans variable, wire & port definitions to correct any inconsistencies
@@ -17,12 +17,12 @@
   along with Minsky.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "variableValue.h"
+#include "minsky.h"
 #include <ecolab_epilogue.h>
 
 namespace minsky
 {
-  std::vector<double> ValueVector::stockVars(1);
-  std::vector<double> ValueVector::flowVars(1);
+  ValueVector& valueVector() {return minsky();}
 
   VariableValue& VariableValue::allocValue()
   {
@@ -33,16 +33,22 @@ namespace minsky
         break;
       case VariableBase::flow:
       case VariableBase::tempFlow:
-        m_idx=ValueVector::flowVars.size();
-        ValueVector::flowVars.resize(ValueVector::flowVars.size()+1);
-        *this=init;
-        break;
+        {
+          vector<double>& flowVars=valueVector().flowVars;
+          m_idx=flowVars.size();
+          flowVars.resize(flowVars.size()+1);
+          *this=init;
+          break;
+        }
       case VariableBase::stock:
       case VariableBase::integral:
-        m_idx=ValueVector::stockVars.size();
-        ValueVector::stockVars.resize(ValueVector::stockVars.size()+1);
-        *this=init;
-        break;
+        {
+          vector<double>& stockVars=valueVector().stockVars;
+          m_idx=stockVars.size();
+          stockVars.resize(stockVars.size()+1);
+          *this=init;
+          break;
+        }
       }
     return *this;
   }
@@ -55,12 +61,12 @@ namespace minsky
       {
       case VariableBase::flow:
       case VariableBase::tempFlow:
-        assert(m_idx<ValueVector::flowVars.size());
-        return ValueVector::flowVars[m_idx];
+        assert(m_idx<valueVector().flowVars.size());
+        return valueVector().flowVars[m_idx];
       case VariableBase::stock:
       case VariableBase::integral:
-        assert(m_idx<ValueVector::stockVars.size());
-        return ValueVector::stockVars[m_idx];
+        assert(m_idx<valueVector().stockVars.size());
+        return valueVector().stockVars[m_idx];
       }
     return init;
   }
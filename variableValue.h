@@ -71,12 +71,17 @@ namespace minsky
   {
     /// vector of variables that are integrated via Runge-Kutta. These
     /// variables label the columns of the Godley table
-    static std::vector<double> stockVars;
+    std::vector<double> stockVars;
     /// variables defined as a simple function of the stock variables,
     /// also known as lhs variables. These variables appear in the body
     /// of the Godley table
-    static std::vector<double> flowVars;
+    std::vector<double> flowVars;
+    ValueVector(): stockVars(1), flowVars(1) {}
   };
+
+  /// value vector that VariableValues refer to, being that of the
+  /// minsky object of the calling thread
+  ValueVector& valueVector();
 }
 #include "variableValue.cd"
 #endif
@@ -23,23 +23,25 @@
 using namespace minsky;
 using namespace ecolab;
 
-void Wire::zoom(float xOrigin, float yOrigin, float factor)
+void Wire::zoom(float xOrigin, float yOrigin, double factor)
 {
+  if (!visible) return;
   if (group>-1)
     {
       GroupIcon& g=minsky().groupItems[group];
       xOrigin-=g.x();
       yOrigin-=g.y();
     }
-  if (visible)
-    for (size_t i=0; i<m_coords.size(); ++i)
-      minsky::zoom(m_coords[i], (i&1)? yOrigin: xOrigin, factor);
+  for (size_t i=0; i<m_coords.size(); ++i)
+    minsky::zoom(m_coords[i], (i&1)? yOrigin: xOrigin, factor);
+  minsky().canvasJournal.touched(this);
 }
 
 void Wire::move(float dx, float dy)
 {
   m_coords[pcoord(m_coords.size()/2)*2]+=dx;
   m_coords[pcoord(m_coords.size()/2)*2+1]+=dy;
+  minsky().canvasJournal.touched(this);
   assert(m_coords.size()>=4);
   array<float> coords=Coords();
   portManager().movePortTo(from, coords[0], coords[1]);
@@ -68,6 +70,7 @@ ecolab::array<float> Wire::Coords(const ecolab::array<float>& coords)
       offs[pcoord(coords.size()/2)*2+1]=g.y();
     }
   m_coords=coords-offs;
+  minsky().canvasJournal.touched(this);
   return coords;
 }
 
@@ -59,7 +59,7 @@ namespace minsky
       from(from), to(to), m_coords(coords), visible(visible), group(-1) {}
     /// zoom by \a factor, scaling all widget's coordinates, using (\a
     /// xOrigin, \a yOrigin) as the origin of the zoom transformation
-    void zoom(float xOrigin, float yOrigin, float factor);
+    void zoom(float xOrigin, float yOrigin, double factor);
     /// move wire by \a dx, \a dy. End ports are moved also
     void move(float dx, float dy);
   };
@@ -281,7 +281,7 @@ proc cancelPlaceNewOp {id} {
     bind .wiring.canvas <Button> {}
     .wiring.canvas delete op$id
     deleteOperation $id
-    updateCanvas
+    refreshCanvas
 }
 
 proc cancelPlaceNewOp {id} {
@@ -289,7 +289,7 @@ proc cancelPlaceNewOp {id} {
     bind .wiring.canvas <Enter> {}
     .wiring.canvas delete op$id
     deleteOperation $id
-    updateCanvas
+    refreshCanvas
 }
 
 proc drawOperation {id} {
@@ -711,6 +711,27 @@ proc recentreCanvas {} {
     .wiring.canvas xview moveto 0.5
     .wiring.canvas yview moveto 0.5
 }
+# draw a single canvas item, where kind is its canvas tag prefix
+proc drawCanvasItem {kind id} {
+    switch $kind {
+        groupItem {newGroupItem $id}
+        var {newVar $id}
+        op {
+            drawOperation $id
+            if {[op.name]=="constant"} {drawSlider $id [op.x] [op.y]}
+        }
+        wire {
+            wire.get $id
+            newWire [createWire [wire.coords]] $id
+        }
+        plot {
+            plot.get $id
+            newPlotItem $id [plot.x] [plot.y]
+        }
+        godley {newGodleyItem $id}
+    }
+}
+
 proc updateCanvas {} {
     disableEventProcessing
     global fname showPorts
@@ -738,15 +759,12 @@ proc updateCanvas {} {
     # add wires to canvas
     foreach w [visibleWires] {
         if {[llength [.wiring.canvas find withtag wire$w]]==0} {
-            wire.get $w
-            set id [createWire [wire.coords]]
-            newWire $id $w 
+            drawCanvasItem wire $w
         }
     }
 
     foreach im [plots.plots.#keys] {
-        plot.get $im
-        newPlotItem $im [plot.x] [plot.y]
+        drawCanvasItem plot $im
     }
 
     foreach g [godleyItems.#keys] {
@@ -769,6 +787,23 @@ proc updateCanvas {} {
 #        adjustWire $port
 #    }
 
+    # the canvas is now up to date with the model
+    canvasChanges
+    enableEventProcessing
+}
+
+# redraw only the canvas items that have been created, modified or
+# deleted since the canvas was last brought up to date
+proc refreshCanvas {} {
+    disableEventProcessing
+    foreach {change kind id} [canvasChanges] {
+        switch $kind {
+            op {.wiring.canvas delete op$id slider$id}
+            plot {.wiring.canvas delete plot#$id}
+            default {.wiring.canvas delete $kind$id}
+        }
+        if {$change!="deleted"} {drawCanvasItem $kind $id}
+    }
     enableEventProcessing
 }
 
@@ -800,7 +835,7 @@ proc toggleCoupled {id} {
     integral.get $id
     integral.toggleCoupled
     integral.set
-    updateCanvas
+    refreshCanvas
 }
 
 # context menu
@@ -897,7 +932,7 @@ proc deleteItem {id tag} {
     switch -regexp $tag {
         "^op" {
             deleteOperation $id
-            updateCanvas
+            refreshCanvas
         }
         "^wire" {
             .wiring.canvas delete handles
@@ -905,12 +940,12 @@ proc deleteItem {id tag} {
         }
         "^var" {
             deleteVariable $id
-            updateCanvas
+            refreshCanvas
         }
         "^godley" {
             deleteGodleyTable $id
             destroy .godley$id
-            updateCanvas
+            refreshCanvas
         }
     }
 }
@@ -1102,7 +1137,7 @@ proc setInitVal {var dialogCmd} {
 proc closeEditWindow {window} {
     grab release $window
     wm withdraw $window
-    updateCanvas
+    refreshCanvas
 }
 
 proc setConstantValue {} {
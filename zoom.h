@@ -22,8 +22,9 @@
 
 namespace minsky
 {
-  /// base zooming transformation
-  inline void zoom(float& val, float origin, float factor)
+  /// base zooming transformation. Evaluated in double precision, so
+  /// that each zoom step rounds \a val only once
+  inline void zoom(float& val, double origin, double factor)
   {val = (val-origin)*factor + origin;}
 
 }